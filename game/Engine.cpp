@@ -1,5 +1,6 @@
 #include "Engine.hpp"
 
+#include "system\Hierarchy.hpp"
 #include "system\Window.hpp"
 #include "system\Renderer.hpp"
 #include "system\Controller.hpp"
@@ -14,7 +15,7 @@
 #include <iostream>
 #include <fstream>
 
-Engine::Engine(int argc, char** argv) {
+Engine::Engine(int argc, char** argv) : _workers(std::max(std::thread::hardware_concurrency(), 2u) - 2) {
 	srand(time(0));
 
 	auto dataPath = std::experimental::filesystem::path(argv[0]).replace_filename("data/");
@@ -29,6 +30,12 @@ Engine::Engine(int argc, char** argv) {
 	std::cerr.rdbuf(cerrOut.rdbuf());
 #endif
 
+	// Hierarchy system, swept in update once everything that writes Transforms has run
+	Hierarchy::ConstructorInfo hierarchyInfo;
+	hierarchyInfo.workers = &_workers;
+
+	auto hierarchy = systems.add<Hierarchy>(hierarchyInfo);
+
 	// Renderer system
 	Renderer::ConstructorInfo rendererInfo;
 	rendererInfo.path = dataPath.string();
@@ -37,6 +44,7 @@ Engine::Engine(int argc, char** argv) {
 	rendererInfo.lineVertexShader = "shaders/lineVert.glsl";
 	rendererInfo.lineFragmentShader = "shaders/lineFrag.glsl";
 	rendererInfo.defaultTexture = "checker.png";
+	rendererInfo.hierarchy = hierarchy.get();
 
 	Window::ConstructorInfo windowInfo;
 	windowInfo.defaultWindow.title = "EntityX Engine";
@@ -46,14 +54,31 @@ Engine::Engine(int argc, char** argv) {
 	//windowInfo.debugContext = true;
 
 	Physics::ConstructorInfo physicsInfo;
+	physicsInfo.path = dataPath.string();
 	physicsInfo.defaultGravity = { 0, 0, -980.7f };
-	physicsInfo.stepsPerUpdate = 1;
+	physicsInfo.fixedTimestep = 1.f / 120.f;
+	physicsInfo.maxSubSteps = 8;
+	physicsInfo.threaded = true; // sequential world on its own thread, bullet's scheduler can't follow it there
 	//physicsInfo.debugLines = true;
+	physicsInfo.hierarchy = hierarchy.get();
+	physicsInfo.workers = &_workers;
+	physicsInfo.lodTiers = {
+		{ 0.f, 32.f, 32.f, false },
+		{ 5000.f, 64.f, 64.f, false }, // settle sooner out of sight
+		{ 20000.f, 64.f, 64.f, true }
+	};
+	physicsInfo.layers = {
+		{ "default" },
+		{ "static", { "static" } }, // the world never moves against itself
+		{ "debris", { "debris" } }, // loose bits only settle on the world and solid bodies
+		{ "trigger", { "static", "trigger" } } // volumes only care about things moving through them
+	};
 
 	Audio::ConstructorInfo audioInfo;
 	audioInfo.sampleRate = 48000;
 	audioInfo.frameSize = 512;
 	audioInfo.path = dataPath.string();
+	audioInfo.hierarchy = hierarchy.get();
 
 	// Register systems
 	systems.add<Window>(windowInfo);
@@ -126,8 +151,54 @@ void Engine::receive(const KeyInputEvent& keyInputEvent) {
 	}
 }
 
+void Engine::spawnBatch(uint32_t count, const std::function<void(entityx::Entity, uint32_t)>& setup, std::vector<entityx::Entity>* spawned) {
+	auto physics = systems.system<Physics>();
+	physics->beginBatch();
+
+	if (spawned)
+		spawned->reserve(spawned->size() + count);
+
+	for (uint32_t i = 0; i < count; i++) {
+		entityx::Entity entity = entities.create();
+		setup(entity, i);
+
+		if (spawned)
+			spawned->push_back(entity);
+	}
+
+	physics->endBatch();
+}
+
+void Engine::destroyBatch(const std::vector<entityx::Entity>& batch) {
+	auto physics = systems.system<Physics>();
+	physics->beginBatch();
+
+	for (entityx::Entity entity : batch) {
+		// may have gone with an earlier entity's subtree
+		if (!entity.valid())
+			continue;
+
+		if (entity.has_component<Transform>())
+			Transform::destroySubtree(entity);
+		else
+			entity.destroy();
+	}
+
+	physics->endBatch();
+}
+
 void Engine::update(double dt){
-	systems.update_all(dt);
+	// update_all runs systems in no set order, world transforms have to be swept between the writers and the readers
+	systems.update<Window>(dt);
+	systems.update<Controller>(dt);
+	systems.update<Physics>(dt);
+
+	systems.update<Hierarchy>(dt);
+
+	systems.update<Renderer>(dt);
+	systems.update<Interface>(dt);
+	systems.update<Audio>(dt);
+	systems.update<Lightmaps>(dt);
 }
 
 int Engine::run() {
@@ -4,8 +4,13 @@
 
 #include "system\WindowEvents.hpp"
 
+#include "other\WorkerPool.hpp"
+
 #include <glm\vec3.hpp>
 
+#include <vector>
+#include <functional>
+
 class Engine : public entityx::EntityX, public entityx::Receiver<Engine> {
 protected:
 	bool _running = true;
@@ -13,6 +18,8 @@ protected:
 
 	bool _wasHovering = false;
 
+	WorkerPool _workers; // leaves a core each to the main thread and Physics' thread
+
 public:
 	Engine(int argc, char** argv);
 
@@ -21,6 +28,11 @@ public:
 	virtual void receive(const WindowOpenEvent& windowOpenEvent);
 	virtual void receive(const KeyInputEvent& keyInputEvent);
 
+	// creates count entities and runs setup on each, colliders assigned there are added to physics together
+	void spawnBatch(uint32_t count, const std::function<void(entityx::Entity, uint32_t)>& setup, std::vector<entityx::Entity>* spawned = nullptr);
+	// destroys the entities and everything parented to them, colliders are removed from physics together
+	void destroyBatch(const std::vector<entityx::Entity>& batch);
+
 	virtual void update(double dt);
 	int run();
 };
\ No newline at end of file
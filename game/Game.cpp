@@ -19,7 +19,6 @@
 /*
 Bugs:
 - Wrong bullet scaling coordinates
-- Colliders as children
 - Colliders on Transform add and remove
 - Imgui keyboard input not working
 
@@ -28,7 +27,7 @@ General:
 - Dynamic collision shape properties (scaling, weight, com)
 - Raycasting from view (highlighting objects, moving axis object)
 - Components/events for physics constraints/raycasting
-- Hierarchy Helper (find by name, find in child, root, destroying children, removing parents)
+- Hierarchy Helper (find by name, find in child, root)
 - Threaded sound, mesh, and texture loading
 
 Big:
@@ -50,7 +49,7 @@ Game::Game(int argc, char** argv) : Engine(argc, argv){
 		_body = entities.create();
 
 		auto bodyTransform = _body.assign<Transform>();
-		bodyTransform->position = _spawnLocation;
+		bodyTransform->setPosition(_spawnLocation);
 
 		Collider::BodyInfo bodyInfo;
 		bodyInfo.type = Collider::Solid;
@@ -70,8 +69,8 @@ Game::Game(int argc, char** argv) : Engine(argc, argv){
 		_head = entities.create();
 
 		auto headTransform = _head.assign<Transform>();
-		headTransform->parent = _body;
-		headTransform->position = { 0.f, 0.f, 150.f / 2.f };
+		headTransform->setParent(_head, _body);
+		headTransform->setPosition({ 0.f, 0.f, 150.f / 2.f });
 
 		auto headCamera = _head.assign<Camera>();
 		headCamera->verticalFov = 90.f;
@@ -83,6 +82,7 @@ Game::Game(int argc, char** argv) : Engine(argc, argv){
 		// Set as controlled (enabled on focus event)
 		systems.system<Controller>()->setControlled(_head, _body);
 		systems.system<Controller>()->setEnabled(false);
+		systems.system<Physics>()->setLodFocus(_body);
 	}
 
 	// Floor
@@ -90,13 +90,14 @@ Game::Game(int argc, char** argv) : Engine(argc, argv){
 		entityx::Entity plane = entities.create();
 
 		auto transform = plane.assign<Transform>();
-		transform->scale *= 50000;
+		transform->localScale(glm::vec3(50000));
 
 		auto model = plane.assign<Model>(Model::FilePaths{ "shapes/plane.obj", 0, "grass.png" });
 		model->textureScale *= 100;
 
 		Collider::BodyInfo bodyInfo;
 		bodyInfo.type = Collider::Static;
+		bodyInfo.layer = "static";
 		bodyInfo.defaultRestitution = 1;
 
 		auto collider = plane.assign<Collider>(Collider::ShapeInfo{ Collider::Plane }, bodyInfo);
@@ -107,7 +108,7 @@ Game::Game(int argc, char** argv) : Engine(argc, argv){
 		entityx::Entity skybox = entities.create();
 
 		auto transform = skybox.assign<Transform>();
-		transform->scale *= 5000;
+		transform->localScale(glm::vec3(5000));
 
 		skybox.assign<Model>(Model::FilePaths{ "skybox.obj", 0, "skybox.png" });
 	}
@@ -117,11 +118,28 @@ Game::Game(int argc, char** argv) : Engine(argc, argv){
 		entityx::Entity scene = entities.create();
 	
 		auto transform = scene.assign<Transform>();
-		transform->position = { 0, 1000, 1 };
-		transform->scale *= 0.8f;
-		transform->rotation = glm::quat({ glm::radians(90.f), 0.f, 0.f });
+		transform->setPosition({ 0, 1000, 1 });
+		transform->localScale(glm::vec3(0.8f));
+		transform->setRotation(glm::quat({ glm::radians(90.f), 0.f, 0.f }));
 	
 		systems.system<Renderer>()->createScene(entities, "triangle_room.fbx", scene);
+
+		// collide with the drawn meshes
+		Collider::BodyInfo bodyInfo;
+		bodyInfo.type = Collider::Static;
+		bodyInfo.layer = "static";
+
+		for (auto child : Transform::subtree(scene)) {
+			if (!child.has_component<Model>())
+				continue;
+
+			Collider::ShapeInfo shapeInfo;
+			shapeInfo.type = Collider::Mesh;
+			shapeInfo.meshFile = child.component<Model>()->filePaths.meshFile;
+			shapeInfo.meshIndex = child.component<Model>()->filePaths.meshIndex;
+
+			child.assign<Collider>(shapeInfo, bodyInfo);
+		}
 	}
 
 	// Speakers
@@ -129,9 +147,9 @@ Game::Game(int argc, char** argv) : Engine(argc, argv){
 		entityx::Entity speaker = entities.create();
 
 		auto transform = speaker.assign<Transform>();
-		transform->position = Transform::forward * 1000.f + Transform::up * 400.f;
-		transform->rotation = glm::quat(glm::vec3(glm::half_pi<float>(), 0, 0));
-		transform->scale *= 0.5f;
+		transform->setPosition(Transform::forward * 1000.f + Transform::up * 400.f);
+		transform->setRotation(glm::quat(glm::vec3(glm::half_pi<float>(), 0, 0)));
+		transform->localScale(glm::vec3(0.5f));
 
 		speaker.assign<Model>(Model::FilePaths{ "speaker.obj", 0, "speaker.png" });
 
@@ -139,7 +157,11 @@ Game::Game(int argc, char** argv) : Engine(argc, argv){
 		bodyInfo.type = Collider::Kinematic;
 		bodyInfo.alwaysActive = true;
 
-		speaker.assign<Collider>(Collider::ShapeInfo{ Collider::Box, 100, 100, 50 }, bodyInfo);
+		Collider::ShapeInfo shapeInfo;
+		shapeInfo.type = Collider::ConvexMesh;
+		shapeInfo.meshFile = "speaker.obj";
+
+		speaker.assign<Collider>(shapeInfo, bodyInfo);
 
 		Sound::Settings soundInfo;
 		soundInfo.radius = 50000;
@@ -155,8 +177,8 @@ Game::Game(int argc, char** argv) : Engine(argc, argv){
 		entityx::Entity platform = entities.create();
 
 		auto transform = platform.assign<Transform>();
-		transform->position = Transform::left * 1000.f + Transform::up * 100.f;
-		transform->scale = { 100, 100, 10 };
+		transform->setPosition(Transform::left * 1000.f + Transform::up * 100.f);
+		transform->setScale({ 100, 100, 10 });
 
 		Collider::ShapeInfo shapeInfo;
 		shapeInfo.type = Collider::Box;
@@ -186,7 +208,7 @@ void Game::receive(const PhysicsUpdateEvent & physicsEvent){
 
 		glm::quat rotation = glm::quat({ 0, 0, glm::radians(5 * physicsEvent.timestep) });
 
-		transform->position = rotation * transform->position;
+		transform->setPosition(rotation * transform->position());
 		transform->globalRotate(rotation);
 	}
 }
@@ -194,7 +216,7 @@ void Game::receive(const PhysicsUpdateEvent & physicsEvent){
 void Game::receive(const MousePressEvent& mousePressEvent){
 	Engine::receive(mousePressEvent);
 
-	if (mousePressEvent.action != Action::Press|| !_head.valid())
+	if (mousePressEvent.action != Action::Press|| !_head.valid() || mousePressEvent.button < 1 || mousePressEvent.button > 3)
 		return;
 
 	auto headTransform = _head.component<Transform>();
@@ -207,17 +229,18 @@ void Game::receive(const MousePressEvent& mousePressEvent){
 	glm::vec3 position = globalHeadRotation * Transform::forward * 200.f;
 	glm::quat rotation = glm::quat({ 0.f, 0.f, glm::eulerAngles(globalHeadRotation).z });
 	
-	for (uint32_t i = 0; i < 1; i++) {
+	// raise to stress test spawning
+	const uint32_t spawnCount = 1;
+
+	spawnBatch(spawnCount, [&](entityx::Entity testent, uint32_t i) {
 		switch (mousePressEvent.button) {
 		case 1:
 		{
 			// Pizza box
-			entityx::Entity testent = entities.create();
-
 			auto transform = testent.assign<Transform>();
-			transform->rotation = rotation;
-			transform->position = globalHeadPosition + position + Transform::up * (float)i;
-			transform->scale = { 100, 100, 10 };
+			transform->setRotation(rotation);
+			transform->setPosition(globalHeadPosition + position + Transform::up * (float)i);
+			transform->setScale({ 100, 100, 10 });
 
 			Collider::ShapeInfo shapeInfo;
 			shapeInfo.type = Collider::Box;
@@ -240,8 +263,6 @@ void Game::receive(const MousePressEvent& mousePressEvent){
 			//testent.assign<Sound>("sounds/box.wav", soundInfo);
 
 			testent.assign<Model>(Model::FilePaths{ "shapes/cube.obj", 0, "pizza.png" });
-
-			_sandbox.push_back(testent);
 		}
 
 		break;
@@ -249,12 +270,10 @@ void Game::receive(const MousePressEvent& mousePressEvent){
 		case 2:
 		{
 			// Anvil
-			entityx::Entity testent = entities.create();
-
 			auto transform = testent.assign<Transform>();
-			transform->rotation = rotation;
-			transform->position = globalHeadPosition + position + Transform::up * (float)i;
-			transform->scale *= 100;
+			transform->setRotation(rotation);
+			transform->setPosition(globalHeadPosition + position + Transform::up * (float)i);
+			transform->localScale(glm::vec3(100));
 
 			Collider::BodyInfo bodyInfo;
 			bodyInfo.type = Collider::Solid;
@@ -267,7 +286,12 @@ void Game::receive(const MousePressEvent& mousePressEvent){
 			bodyInfo.mass = 50000;
 			bodyInfo.callbacks = true;
 
-			testent.assign<Collider>(Collider::ShapeInfo{ Collider::Box, 1.5,1.5,1.5 }, bodyInfo);
+			Collider::ShapeInfo shapeInfo;
+			shapeInfo.type = Collider::ConvexMesh;
+			shapeInfo.meshFile = "anvil.obj";
+			shapeInfo.maxHulls = 8;
+
+			testent.assign<Collider>(shapeInfo, bodyInfo);
 
 			Sound::Settings soundInfo;
 			soundInfo.loop = false;
@@ -279,8 +303,6 @@ void Game::receive(const MousePressEvent& mousePressEvent){
 			//testent.assign<Sound>("sounds/thud.wav", soundInfo);
 
 			testent.assign<Model>(Model::FilePaths{ "anvil.obj", 0, "anvil.png" });
-
-			_sandbox.push_back(testent);
 		}
 
 		break;
@@ -288,12 +310,10 @@ void Game::receive(const MousePressEvent& mousePressEvent){
 		case 3:
 		{
 			// Beachball
-			entityx::Entity testent = entities.create();
-
 			auto transform = testent.assign<Transform>();
-			transform->rotation = rotation;
-			transform->position = globalHeadPosition + position + Transform::up * (float)i;
-			transform->scale *= 64;
+			transform->setRotation(rotation);
+			transform->setPosition(globalHeadPosition + position + Transform::up * (float)i);
+			transform->localScale(glm::vec3(64));
 
 			Collider::ShapeInfo shapeInfo;
 			shapeInfo.type = Collider::Sphere;
@@ -321,13 +341,11 @@ void Game::receive(const MousePressEvent& mousePressEvent){
 			//testent.assign<Sound>("sounds/ball.wav", soundInfo);
 
 			testent.assign<Model>(Model::FilePaths{ "shapes/sphere.obj", 0, "beachball.png" });
-
-			_sandbox.push_back(testent);
 		}
 
 		break;
 		}
-	}
+	}, &_sandbox);
 }
 
 void Game::receive(const KeyInputEvent& keyInputEvent){
@@ -336,9 +354,7 @@ void Game::receive(const KeyInputEvent& keyInputEvent){
 	if (keyInputEvent.action != Action::Press || keyInputEvent.key != Key::Key_R)
 		return;
 
-	for (auto entity : _sandbox)
-		entity.destroy();
-
+	destroyBatch(_sandbox);
 	_sandbox.clear();
 }
 
@@ -0,0 +1,139 @@
+#include "other\Broadphase.hpp"
+#include "other\Time.hpp"
+
+#include <btBulletCollisionCommon.h>
+
+#include <random>
+#include <memory>
+#include <cmath>
+#include <vector>
+#include <cstdio>
+
+/*
+Pair update times of each broadphase on the same bodies, no world or solver.
+
+Every frame a share of the bodies drift a little, then setAabb and calculateOverlappingPairs
+are timed together. Like the world's aabb pass, setAabb is called on every awake body, including
+awake ones that didn't move. Bodies keep the same density at every count, spread evenly or in clusters,
+so it shows how each broadphase scales with the layouts levels actually use.
+*/
+
+struct Scenario {
+	const char* name;
+	uint32_t bodyCount;
+	bool clustered;
+};
+
+struct Result {
+	double frameMs = 0.0;
+	double pairCount = 0.0;
+};
+
+const uint32_t frames = 120;
+const float awakeShare = 0.5f; // the world updates awake bodies' bounds whether they moved or not
+const float movingShare = 0.2f;
+const float bodyRadius = 50.f;
+const float spacing = 400.f; // average distance between body centres
+
+Result runScenario(const BroadphaseInfo& broadphaseInfo, const Scenario& scenario) {
+	btDefaultCollisionConfiguration collisionConfiguration;
+	btCollisionDispatcher dispatcher(&collisionConfiguration);
+
+	std::unique_ptr<btBroadphaseInterface> broadphase = createBroadphase(broadphaseInfo);
+
+	std::mt19937 random(scenario.bodyCount);
+
+	// same density at every count, clusters pack a quarter of the volume
+	const float side = spacing * std::cbrt((float)scenario.bodyCount);
+	std::uniform_real_distribution<float> spread(-side / 2.f, side / 2.f);
+	std::uniform_real_distribution<float> clusterSpread(-side / 8.f, side / 8.f);
+	std::uniform_real_distribution<float> drift(-bodyRadius / 4.f, bodyRadius / 4.f);
+
+	const uint32_t clusterCount = 8;
+	std::vector<btVector3> clusters;
+
+	for (uint32_t i = 0; i < clusterCount; i++)
+		clusters.push_back(btVector3(spread(random), spread(random), spread(random)) * 0.5f);
+
+	std::vector<btVector3> positions(scenario.bodyCount);
+	std::vector<btBroadphaseProxy*> proxies(scenario.bodyCount);
+
+	const btVector3 extents(bodyRadius, bodyRadius, bodyRadius);
+
+	for (uint32_t i = 0; i < scenario.bodyCount; i++) {
+		if (scenario.clustered)
+			positions[i] = clusters[i % clusterCount] + btVector3(clusterSpread(random), clusterSpread(random), clusterSpread(random));
+		else
+			positions[i] = btVector3(spread(random), spread(random), spread(random));
+
+		proxies[i] = broadphase->createProxy(positions[i] - extents, positions[i] + extents, SPHERE_SHAPE_PROXYTYPE, nullptr, btBroadphaseProxy::DefaultFilter, btBroadphaseProxy::AllFilter, &dispatcher);
+	}
+
+	broadphase->calculateOverlappingPairs(&dispatcher);
+
+	const uint32_t awakeCount = (uint32_t)(scenario.bodyCount * awakeShare);
+	const uint32_t movingCount = (uint32_t)(scenario.bodyCount * movingShare);
+
+	Result result;
+	TimePoint timer;
+
+	for (uint32_t frame = 0; frame < frames; frame++) {
+		for (uint32_t i = 0; i < movingCount; i++)
+			positions[i] += btVector3(drift(random), drift(random), drift(random));
+
+		startTime(&timer);
+
+		for (uint32_t i = 0; i < awakeCount; i++)
+			broadphase->setAabb(proxies[i], positions[i] - extents, positions[i] + extents, &dispatcher);
+
+		broadphase->calculateOverlappingPairs(&dispatcher);
+
+		result.frameMs += deltaTime(timer) * 1000.0;
+		result.pairCount += broadphase->getOverlappingPairCache()->getNumOverlappingPairs();
+	}
+
+	for (btBroadphaseProxy* proxy : proxies)
+		broadphase->destroyProxy(proxy, &dispatcher);
+
+	result.frameMs /= frames;
+	result.pairCount /= frames;
+
+	return result;
+}
+
+int main(int argc, char** argv) {
+	const Scenario scenarios[] = {
+		{ "uniform", 1000, false },
+		{ "uniform", 10000, false },
+		{ "uniform", 50000, false },
+		{ "clustered", 1000, true },
+		{ "clustered", 10000, true },
+		{ "clustered", 50000, true },
+	};
+
+	const char* names[] = { "dbvt", "axis sweep", "grid" };
+
+	BroadphaseInfo broadphaseInfos[3];
+	broadphaseInfos[0].type = BroadphaseInfo::Dbvt;
+	broadphaseInfos[1].type = BroadphaseInfo::AxisSweep;
+	broadphaseInfos[2].type = BroadphaseInfo::Grid;
+	broadphaseInfos[2].cellSize = bodyRadius * 4.f;
+
+	// bounds fit the largest scenario, axis sweep quantizes positions inside them
+	const float bounds = spacing * std::cbrt(50000.f);
+
+	broadphaseInfos[1].worldMin = glm::vec3(-bounds);
+	broadphaseInfos[1].worldMax = glm::vec3(bounds);
+
+	printf("%-10s %-12s %8s %12s %10s\n", "layout", "broadphase", "bodies", "update (ms)", "pairs");
+
+	for (const Scenario& scenario : scenarios) {
+		for (uint32_t i = 0; i < 3; i++) {
+			const Result result = runScenario(broadphaseInfos[i], scenario);
+
+			printf("%-10s %-12s %8u %12.3f %10.0f\n", scenario.name, names[i], scenario.bodyCount, result.frameMs, result.pairCount);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,393 @@
+#include "component\Transform.hpp"
+#include "component\Collider.hpp"
+
+#include "system\Hierarchy.hpp"
+#include "system\Physics.hpp"
+
+#include "other\WorkerPool.hpp"
+#include "other\Time.hpp"
+
+#include <entityx\entityx.h>
+
+#include <LinearMath\btAlignedAllocator.h>
+
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <functional>
+
+/*
+Headless physics scenarios, driven through Collider components like the game does.
+
+Each scenario gets a fresh world and runs a fixed number of updates of exactly one fixed step,
+timing Hierarchy and Physics updates together. Spawning, destroying and scripted movement before
+each step are timed and counted on their own. Results are written as JSON to stdout, or to the
+file passed as the first argument. "--threads N" sets Physics' thread count.
+*/
+
+// every allocation made while timing, operator new and bullet's allocator both count
+std::atomic<uint64_t> allocationCount{ 0 };
+std::atomic<uint64_t> allocationBytes{ 0 };
+
+inline void* countedAlloc(size_t size) {
+	allocationCount++;
+	allocationBytes += size;
+
+	return std::malloc(size ? size : 1);
+}
+
+void* operator new(size_t size) {
+	if (void* pointer = countedAlloc(size))
+		return pointer;
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+	std::free(pointer);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+	allocationCount++;
+	allocationBytes += size;
+
+#ifdef _MSC_VER
+	void* pointer = _aligned_malloc(size ? size : 1, (size_t)alignment);
+#else
+	void* pointer = std::aligned_alloc((size_t)alignment, ((size ? size : 1) + (size_t)alignment - 1) / (size_t)alignment * (size_t)alignment);
+#endif
+
+	if (!pointer)
+		throw std::bad_alloc();
+
+	return pointer;
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+#ifdef _MSC_VER
+	_aligned_free(pointer);
+#else
+	std::free(pointer);
+#endif
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t alignment) noexcept {
+	operator delete(pointer, alignment);
+}
+
+void* bulletAlloc(size_t size) {
+	return countedAlloc(size);
+}
+
+void bulletFree(void* pointer) {
+	std::free(pointer);
+}
+
+const double timestep = 1.0 / 120.0;
+
+class Bench : public entityx::EntityX {
+	std::mt19937 _random;
+
+public:
+	WorkerPool workers;
+
+	std::vector<entityx::Entity> spawned;
+	std::vector<entityx::Entity> spinners;
+
+	uint32_t contacts = 0;
+
+	// bullet's scheduler takes threadCount cores counting the calling thread, the pool's workers get the rest
+	Bench(uint32_t threadCount) :
+		_random(1),
+		workers(std::max(std::thread::hardware_concurrency(), threadCount) - threadCount) {
+		Hierarchy::ConstructorInfo hierarchyInfo;
+		hierarchyInfo.workers = &workers;
+
+		auto hierarchy = systems.add<Hierarchy>(hierarchyInfo);
+
+		Physics::ConstructorInfo physicsInfo;
+		physicsInfo.defaultGravity = { 0, 0, -980.7f };
+		physicsInfo.fixedTimestep = (float)timestep;
+		physicsInfo.maxSubSteps = 1;
+		physicsInfo.threadCount = threadCount;
+		physicsInfo.hierarchy = hierarchy.get();
+		physicsInfo.workers = &workers;
+
+		systems.add<Physics>(physicsInfo);
+		systems.configure();
+
+		// floor
+		entityx::Entity floor = entities.create();
+		floor.assign<Transform>();
+
+		Collider::BodyInfo bodyInfo;
+		bodyInfo.type = Collider::Static;
+
+		floor.assign<Collider>(Collider::ShapeInfo{ Collider::Plane }, bodyInfo);
+	}
+
+	float random(float min, float max) {
+		return std::uniform_real_distribution<float>(min, max)(_random);
+	}
+
+	entityx::Entity spawn(Collider::ShapeType shapeType, Collider::BodyType bodyType, const glm::vec3& position, const glm::vec3& scale) {
+		entityx::Entity entity = entities.create();
+
+		auto transform = entity.assign<Transform>();
+		transform->setPosition(position);
+		transform->setScale(scale);
+
+		Collider::ShapeInfo shapeInfo;
+		shapeInfo.type = shapeType;
+
+		Collider::BodyInfo bodyInfo;
+		bodyInfo.type = bodyType;
+		bodyInfo.mass = bodyType == Collider::Solid ? 5.f : 0.f;
+		bodyInfo.alwaysActive = bodyType == Collider::Kinematic;
+		bodyInfo.callbacks = bodyType == Collider::Solid; // listed in the contact stream, so contacts can be counted
+
+		entity.assign<Collider>(shapeInfo, bodyInfo);
+
+		spawned.push_back(entity);
+
+		return entity;
+	}
+
+	// spawns and destroys in between go through Physics together, like Engine's spawnBatch and destroyBatch
+	void beginBatch() {
+		systems.system<Physics>()->beginBatch();
+	}
+
+	void endBatch() {
+		systems.system<Physics>()->endBatch();
+	}
+
+	// one fixed step, returns seconds taken
+	double step() {
+		TimePoint timer;
+		startTime(&timer);
+
+		systems.update<Hierarchy>(timestep);
+		systems.update<Physics>(timestep);
+
+		const double time = deltaTime(timer);
+
+		contacts = (uint32_t)systems.system<Physics>()->contactStream().contacts().size();
+
+		return time;
+	}
+};
+
+struct Scenario {
+	const char* name;
+	uint32_t steps;
+	std::function<void(Bench&)> setup;
+	std::function<void(Bench&, uint32_t)> beforeStep; // optional
+};
+
+const std::vector<Scenario> scenarios = {
+	{
+		"box_pile", 600,
+		[](Bench& bench) {
+			// 10 x 10 columns, 10 boxes high, slightly jittered so the pile collapses
+			for (uint32_t i = 0; i < 1000; i++) {
+				const glm::vec3 position(
+					(float)(i % 10) * 110.f + bench.random(-20.f, 20.f),
+					(float)(i / 10 % 10) * 110.f + bench.random(-20.f, 20.f),
+					200.f + (float)(i / 100) * 120.f);
+
+				bench.spawn(Collider::Box, Collider::Solid, position, { 100.f, 100.f, 100.f });
+			}
+		}
+	},
+	{
+		"sphere_rain", 600,
+		[](Bench& bench) {},
+		[](Bench& bench, uint32_t step) {
+			if (step >= 300)
+				return;
+
+			for (uint32_t i = 0; i < 5; i++)
+				bench.spawn(Collider::Sphere, Collider::Solid, { bench.random(-1000.f, 1000.f), bench.random(-1000.f, 1000.f), 2000.f }, { 50.f, 50.f, 50.f });
+		}
+	},
+	{
+		"stack_tower", 600,
+		[](Bench& bench) {
+			// 4 towers of 30 boxes resting on each other
+			for (uint32_t tower = 0; tower < 4; tower++) {
+				for (uint32_t i = 0; i < 30; i++)
+					bench.spawn(Collider::Box, Collider::Solid, { (float)tower * 300.f, 0.f, 50.f + (float)i * 100.f }, { 100.f, 100.f, 100.f });
+			}
+		}
+	},
+	{
+		"kinematic_spinners", 600,
+		[](Bench& bench) {
+			// 20 x 20 field of spinning platforms, a sphere resting on each
+			for (uint32_t i = 0; i < 400; i++) {
+				const glm::vec3 position((float)(i % 20) * 300.f, (float)(i / 20) * 300.f, 100.f);
+
+				bench.spinners.push_back(bench.spawn(Collider::Box, Collider::Kinematic, position, { 200.f, 200.f, 20.f }));
+				bench.spawn(Collider::Sphere, Collider::Solid, position + glm::vec3(50.f, 0.f, 100.f), { 50.f, 50.f, 50.f });
+			}
+		},
+		[](Bench& bench, uint32_t step) {
+			const glm::quat rotation(glm::vec3(0.f, 0.f, glm::radians(90.f) * (float)timestep));
+
+			for (entityx::Entity spinner : bench.spinners)
+				spinner.component<Transform>()->globalRotate(rotation);
+		}
+	},
+	{
+		"spawn_destroy_churn", 600,
+		[](Bench& bench) {},
+		[](Bench& bench, uint32_t step) {
+			// 20 in and, once 1000 are alive, the oldest 20 out every step
+			bench.beginBatch();
+
+			for (uint32_t i = 0; i < 20; i++)
+				bench.spawn(Collider::Box, Collider::Solid, { bench.random(-2000.f, 2000.f), bench.random(-2000.f, 2000.f), bench.random(100.f, 1000.f) }, { 50.f, 50.f, 50.f });
+
+			bench.endBatch();
+
+			if (bench.spawned.size() <= 1000)
+				return;
+
+			const size_t count = bench.spawned.size() - 1000;
+
+			bench.beginBatch();
+
+			for (size_t i = 0; i < count; i++)
+				bench.spawned[i].destroy();
+
+			bench.endBatch();
+
+			bench.spawned.erase(bench.spawned.begin(), bench.spawned.begin() + count);
+		}
+	}
+};
+
+inline double percentile(const std::vector<double>& sorted, double fraction) {
+	return sorted[std::min((size_t)(fraction * sorted.size()), sorted.size() - 1)];
+}
+
+void runScenario(const Scenario& scenario, uint32_t threadCount, FILE* out, bool last) {
+	Bench bench(threadCount);
+	scenario.setup(bench);
+
+	std::vector<double> times;
+	times.reserve(scenario.steps);
+
+	std::vector<double> scriptTimes;
+	scriptTimes.reserve(scenario.steps);
+
+	uint64_t contacts = 0;
+	uint32_t maxContacts = 0;
+
+	uint64_t allocations = 0;
+	uint64_t allocatedBytes = 0;
+
+	uint64_t scriptAllocations = 0;
+	uint64_t scriptAllocatedBytes = 0;
+
+	for (uint32_t step = 0; step < scenario.steps; step++) {
+		uint64_t countBefore = allocationCount;
+		uint64_t bytesBefore = allocationBytes;
+
+		// spawning, destroying and scripted movement, bodies come and go here rather than in the step
+		TimePoint timer;
+		startTime(&timer);
+
+		if (scenario.beforeStep)
+			scenario.beforeStep(bench, step);
+
+		scriptTimes.push_back(deltaTime(timer) * 1000.0);
+
+		scriptAllocations += allocationCount - countBefore;
+		scriptAllocatedBytes += allocationBytes - bytesBefore;
+
+		countBefore = allocationCount;
+		bytesBefore = allocationBytes;
+
+		times.push_back(bench.step() * 1000.0);
+
+		allocations += allocationCount - countBefore;
+		allocatedBytes += allocationBytes - bytesBefore;
+
+		contacts += bench.contacts;
+		maxContacts = std::max(maxContacts, bench.contacts);
+	}
+
+	double total = 0.0;
+	double scriptTotal = 0.0;
+
+	for (double time : times)
+		total += time;
+
+	for (double time : scriptTimes)
+		scriptTotal += time;
+
+	std::sort(times.begin(), times.end());
+	std::sort(scriptTimes.begin(), scriptTimes.end());
+
+	fprintf(out, "    {\n");
+	fprintf(out, "      \"name\": \"%s\",\n", scenario.name);
+	fprintf(out, "      \"steps\": %u,\n", scenario.steps);
+	fprintf(out, "      \"bodies\": %u,\n", (uint32_t)bench.spawned.size() + 1);
+	fprintf(out, "      \"step_ms\": { \"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f },\n",
+		total / times.size(), percentile(times, 0.5), percentile(times, 0.9), percentile(times, 0.99), times.back());
+	fprintf(out, "      \"contacts_per_step\": { \"mean\": %.2f, \"max\": %u },\n", (double)contacts / scenario.steps, maxContacts);
+	fprintf(out, "      \"allocations_per_step\": { \"count\": %.2f, \"bytes\": %.2f },\n", (double)allocations / scenario.steps, (double)allocatedBytes / scenario.steps);
+	fprintf(out, "      \"script_ms\": { \"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f },\n",
+		scriptTotal / scriptTimes.size(), percentile(scriptTimes, 0.5), percentile(scriptTimes, 0.9), percentile(scriptTimes, 0.99), scriptTimes.back());
+	fprintf(out, "      \"script_allocations_per_step\": { \"count\": %.2f, \"bytes\": %.2f }\n", (double)scriptAllocations / scenario.steps, (double)scriptAllocatedBytes / scenario.steps);
+	fprintf(out, "    }%s\n", last ? "" : ",");
+}
+
+int main(int argc, char** argv) {
+	btAlignedAllocSetCustom(bulletAlloc, bulletFree);
+
+	uint32_t threadCount = 1;
+	const char* outFile = nullptr;
+
+	for (int i = 1; i < argc; i++) {
+		if (!std::strcmp(argv[i], "--threads") && i + 1 < argc)
+			threadCount = (uint32_t)std::max(std::atoi(argv[++i]), 1);
+		else
+			outFile = argv[i];
+	}
+
+	FILE* out = outFile ? fopen(outFile, "w") : stdout;
+
+	if (!out) {
+		fprintf(stderr, "PhysicsBench: couldn't open %s\n", outFile);
+		return 1;
+	}
+
+	fprintf(out, "{\n");
+	fprintf(out, "  \"threads\": %u,\n", threadCount);
+	fprintf(out, "  \"timestep\": %.6f,\n", timestep);
+	fprintf(out, "  \"scenarios\": [\n");
+
+	for (size_t i = 0; i < scenarios.size(); i++)
+		runScenario(scenarios[i], threadCount, out, i + 1 == scenarios.size());
+
+	fprintf(out, "  ]\n");
+	fprintf(out, "}\n");
+
+	if (out != stdout)
+		fclose(out);
+
+	return 0;
+}
@@ -0,0 +1,132 @@
+#include "other\Trs.hpp"
+#include "other\Time.hpp"
+
+#include <glm\gtc\matrix_transform.hpp>
+
+#include <random>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+
+/*
+Checks composeTrs against glm's translate * mat4_cast * scale on random inputs, then times both.
+
+Counts that aren't a multiple of 4 make the SSE path hand its remainder to the scalar one.
+Rotations are normalized and scales may be negative or non-uniform, like Transforms allow.
+Exits with 1 when any element is further off than the tolerance.
+*/
+
+struct Inputs {
+	std::vector<glm::vec3> positions;
+	std::vector<glm::quat> rotations;
+	std::vector<glm::vec3> scales;
+};
+
+const uint32_t repeats = 50;
+const float tolerance = 1e-4f; // relative to the element's magnitude, or absolute below 1
+
+Inputs randomInputs(uint32_t count, uint32_t seed) {
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> position(-10000.f, 10000.f);
+	std::uniform_real_distribution<float> component(-1.f, 1.f);
+	std::uniform_real_distribution<float> scale(0.01f, 100.f);
+	std::bernoulli_distribution flip(0.1);
+
+	Inputs inputs;
+
+	for (uint32_t i = 0; i < count; i++) {
+		inputs.positions.push_back(glm::vec3(position(random), position(random), position(random)));
+
+		glm::quat rotation(component(random), component(random), component(random), component(random));
+
+		// the odd degenerate draw is left as identity
+		if (glm::length(rotation) < 1e-3f)
+			rotation = glm::quat();
+
+		inputs.rotations.push_back(glm::normalize(rotation));
+
+		glm::vec3 bodyScale(scale(random), scale(random), scale(random));
+
+		if (flip(random))
+			bodyScale.y = -bodyScale.y;
+
+		inputs.scales.push_back(bodyScale);
+	}
+
+	return inputs;
+}
+
+void composeGlm(const Inputs& inputs, glm::mat4* matrices, size_t count) {
+	for (size_t i = 0; i < count; i++)
+		matrices[i] = glm::translate(glm::mat4(1.f), inputs.positions[i]) * glm::mat4_cast(inputs.rotations[i]) * glm::scale(glm::mat4(1.f), inputs.scales[i]);
+}
+
+// largest difference over all elements, scaled down for large elements
+float maxError(const std::vector<glm::mat4>& matrices, const std::vector<glm::mat4>& expected) {
+	float error = 0.f;
+
+	for (size_t i = 0; i < matrices.size(); i++) {
+		for (int column = 0; column < 4; column++) {
+			for (int row = 0; row < 4; row++) {
+				const float magnitude = std::fmax(1.f, std::fabs(expected[i][column][row]));
+				error = std::fmax(error, std::fabs(matrices[i][column][row] - expected[i][column][row]) / magnitude);
+			}
+		}
+	}
+
+	return error;
+}
+
+int main(int argc, char** argv) {
+	const uint32_t counts[] = { 1, 3, 4, 7, 1000, 1003, 100000 };
+
+	bool passed = true;
+
+	printf("%8s %12s %12s %12s %12s %12s\n", "count", "glm (us)", "scalar (us)", "sse (us)", "scalar err", "sse err");
+
+	for (uint32_t count : counts) {
+		const Inputs inputs = randomInputs(count, count);
+
+		std::vector<glm::mat4> expected(count);
+		std::vector<glm::mat4> scalar(count);
+		std::vector<glm::mat4> batched(count);
+
+		TimePoint timer;
+
+		startTime(&timer);
+
+		for (uint32_t i = 0; i < repeats; i++)
+			composeGlm(inputs, expected.data(), count);
+
+		const double glmUs = deltaTime(timer) * 1000000.0 / repeats;
+
+		startTime(&timer);
+
+		for (uint32_t i = 0; i < repeats; i++)
+			composeTrsScalar(inputs.positions.data(), inputs.rotations.data(), inputs.scales.data(), scalar.data(), count);
+
+		const double scalarUs = deltaTime(timer) * 1000000.0 / repeats;
+
+		startTime(&timer);
+
+		for (uint32_t i = 0; i < repeats; i++)
+			composeTrs(inputs.positions.data(), inputs.rotations.data(), inputs.scales.data(), batched.data(), count);
+
+		const double batchedUs = deltaTime(timer) * 1000000.0 / repeats;
+
+		const float scalarError = maxError(scalar, expected);
+		const float batchedError = maxError(batched, expected);
+
+		printf("%8u %12.2f %12.2f %12.2f %12.2e %12.2e\n", count, glmUs, scalarUs, batchedUs, scalarError, batchedError);
+
+		if (scalarError > tolerance || batchedError > tolerance)
+			passed = false;
+	}
+
+	if (!passed) {
+		printf("composeTrs differs from glm by more than %.0e\n", tolerance);
+		return 1;
+	}
+
+	return 0;
+}
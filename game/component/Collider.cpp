@@ -2,127 +2,235 @@
 
 #include "component\Name.hpp"
 
+#include "system\Hierarchy.hpp"
+#include "system\Physics.hpp"
+
 Collider::Collider(ShapeInfo shapeInfo, BodyInfo bodyInfo) : 
 	shapeInfo(shapeInfo), 
-	bodyInfo(bodyInfo), 
-	shapeVariant(0), 
-	rigidBody(0, 0, 0) {
+	bodyInfo(bodyInfo) {
 };
 
 void Collider::getWorldTransform(btTransform& worldTransform) const {
 	if (!self.valid() || !self.has_component<Transform>())
 		return;
 
-	auto transform = self.component<const Transform>();
-
 	glm::vec3 globalPosition;
 	glm::quat globalRotation;
 
-	transform->globalDecomposed(&globalPosition, &globalRotation);
+	hierarchy->globalDecomposed(self, &globalPosition, &globalRotation);
 
 	worldTransform.setOrigin(toBt(globalPosition));
 	worldTransform.setRotation(toBt(globalRotation));
 }
 
-void Collider::setWorldTransform(const btTransform& worldTransform) {
-	if (!self.valid() || !self.has_component<Transform>())
+void Collider::setActive(bool active){
+	// triggers have no body, only ghosts that follow their Transform
+	if (!rigidBody)
 		return;
 
-	auto transform = self.component<Transform>();
-
-	glm::vec3 globalPosition = fromBt(worldTransform.getOrigin());
-	glm::quat globalRotation = fromBt(worldTransform.getRotation());
-
-	glm::mat4 globalMatrix;
-	worldTransform.getOpenGLMatrix((btScalar*)&globalMatrix[0]);
-
-	//if (self.has_component<Name>() && self.component<Name>()->name == "test")
-	//	printf("setWorldTransform\n");
-
-	if (transform->parent.valid() && transform->parent.has_component<Transform>()) {
-		//glm::vec3 parentGlobalPosition;
-		//glm::quat parentGlobalRotation;
-		//
-		//transform->parent.component<Transform>()->globalDecomposed(&parentGlobalPosition, &parentGlobalRotation);
-		//
-		//transform->position = (globalPosition - parentGlobalPosition) * parentGlobalRotation;
-		//transform->rotation = glm::inverse(parentGlobalRotation) * transform->rotation; // working???
-
-		//glm::mat4 parentMatrix = transform->parent.component<Transform>()->globalMatrix();
-
-		//glm::mat4 localMatrix = glm::inverse(parentMatrix) * globalMatrix;
-		//glm::mat4 localMatrix = globalMatrix * glm::inverse(parentMatrix);
-		//glm::mat4 localMatrix = glm::inverse(globalMatrix) * parentMatrix;
-		//glm::mat4 localMatrix = parentMatrix * glm::inverse(globalMatrix);
-
-		//glm::vec3 localPosition;
-		//glm::quat localRotation;
-		//glm::decompose(localMatrix, glm::vec3(), localRotation, localPosition, glm::vec3(), glm::vec4());
-		
-		//transform->position = localPosition;
-		//transform->rotation = localRotation;
-	}
-	else {
-		transform->position = globalPosition;
-		transform->rotation = globalRotation;
-	}
-}
-
-void Collider::setActive(bool active){
-	rigidBody.activate(active);
+	btRigidBody* body = rigidBody;
+	physics->command(body, [body, active] { body->activate(active); });
 }
 
 void Collider::setAlwaysActive(bool alwaysActive){
-	if (alwaysActive)
-		rigidBody.setActivationState(DISABLE_DEACTIVATION);
-	else
-		rigidBody.setActivationState(ACTIVE_TAG);
+	if (!rigidBody)
+		return;
+
+	btRigidBody* body = rigidBody;
+
+	physics->command(body, [body, alwaysActive] {
+		if (alwaysActive)
+			body->setActivationState(DISABLE_DEACTIVATION);
+		else
+			body->setActivationState(ACTIVE_TAG);
+	});
 }
 
 void Collider::setLinearVelocity(const glm::vec3& velocity){
-	rigidBody.setLinearVelocity(toBt(velocity));
+	if (!rigidBody)
+		return;
+
+	btRigidBody* body = rigidBody;
+	const btVector3 linearVelocity = toBt(velocity);
+
+	// read back straight away, before the physics thread applies it
+	((ColliderMotionState*)body->getMotionState())->syncedLinearVelocity = linearVelocity;
+
+	physics->command(body, [body, linearVelocity] { body->setLinearVelocity(linearVelocity); });
 }
 
 void Collider::setAngularVelocity(const glm::vec3& velocity) {
-	rigidBody.setAngularVelocity(toBt(velocity));
+	if (!rigidBody)
+		return;
+
+	btRigidBody* body = rigidBody;
+	const btVector3 angularVelocity = toBt(velocity);
+
+	((ColliderMotionState*)body->getMotionState())->syncedAngularVelocity = angularVelocity;
+
+	physics->command(body, [body, angularVelocity] { body->setAngularVelocity(angularVelocity); });
 }
 
 void Collider::setLinearFactor(const glm::vec3 & factor){
-	rigidBody.setLinearFactor(toBt(factor));
+	if (!rigidBody)
+		return;
+
+	btRigidBody* body = rigidBody;
+	const btVector3 linearFactor = toBt(factor);
+
+	physics->command(body, [body, linearFactor] { body->setLinearFactor(linearFactor); });
 }
 
 void Collider::setAngularFactor(const glm::vec3 & factor){
-	rigidBody.setAngularFactor(toBt(factor));
+	if (!rigidBody)
+		return;
+
+	btRigidBody* body = rigidBody;
+	const btVector3 angularFactor = toBt(factor);
+
+	physics->command(body, [body, angularFactor] { body->setAngularFactor(angularFactor); });
 }
 
 void Collider::setFriction(float friction){
-	rigidBody.setFriction(friction);
+	if (!rigidBody)
+		return;
+
+	btRigidBody* body = rigidBody;
+	physics->command(body, [body, friction] { body->setFriction(friction); });
 }
 
 void Collider::setRestitution(float restitution){
-	rigidBody.setRestitution(restitution);
+	if (!rigidBody)
+		return;
+
+	btRigidBody* body = rigidBody;
+	physics->command(body, [body, restitution] { body->setRestitution(restitution); });
 }
 
 void Collider::setGravity(const glm::vec3 & gravity){
-	rigidBody.setGravity(toBt(gravity));
+	if (!rigidBody)
+		return;
+
+	btRigidBody* body = rigidBody;
+	const btVector3 bodyGravity = toBt(gravity);
+
+	physics->command(body, [body, bodyGravity] { body->setGravity(bodyGravity); });
 }
 
 glm::vec3 Collider::getLinearVelocity() const{
-	return fromBt(rigidBody.getLinearVelocity());
+	if (!rigidBody)
+		return glm::vec3();
+
+	if (physics->threaded())
+		return fromBt(((ColliderMotionState*)rigidBody->getMotionState())->syncedLinearVelocity);
+
+	return fromBt(rigidBody->getLinearVelocity());
 }
 
 glm::vec3 Collider::getAngularVelocity() const{
-	return fromBt(rigidBody.getAngularVelocity());
+	if (!rigidBody)
+		return glm::vec3();
+
+	if (physics->threaded())
+		return fromBt(((ColliderMotionState*)rigidBody->getMotionState())->syncedAngularVelocity);
+
+	return fromBt(rigidBody->getAngularVelocity());
 }
 
 float Collider::getInvMass() const{
-	return rigidBody.getInvMass();
+	if (!rigidBody)
+		return 0.f;
+
+	return rigidBody->getInvMass();
 }
 
 void Collider::applyForce(const glm::vec3 & force){
-	rigidBody.applyCentralForce(toBt(force));
+	if (!rigidBody)
+		return;
+
+	btRigidBody* body = rigidBody;
+	const btVector3 centralForce = toBt(force);
+
+	physics->command(body, [body, centralForce] { body->applyCentralForce(centralForce); });
 }
 
 void Collider::applyImpulse(const glm::vec3 impulse){
-	rigidBody.applyCentralImpulse(toBt(impulse));
+	if (!rigidBody)
+		return;
+
+	btRigidBody* body = rigidBody;
+	const btVector3 centralImpulse = toBt(impulse);
+
+	physics->command(body, [body, centralImpulse] { body->applyCentralImpulse(centralImpulse); });
+}
+
+void Collider::setWorldTransform(const btTransform& worldTransform) {
+	if (!self.valid() || !self.has_component<Transform>())
+		return;
+
+	auto transform = self.component<Transform>();
+
+	glm::vec3 globalPosition = fromBt(worldTransform.getOrigin());
+	glm::quat globalRotation = fromBt(worldTransform.getRotation());
+
+	if (!transform->parent().valid() || !transform->parent().has_component<Transform>()) {
+		transform->setPosition(globalPosition);
+		transform->setRotation(globalRotation);
+		return;
+	}
+
+	// into the parent's space, its scale divides out of the position
+	glm::vec3 parentPosition;
+	glm::quat parentRotation;
+	glm::vec3 parentScale;
+
+	hierarchy->globalDecomposed(transform->parent(), &parentPosition, &parentRotation, &parentScale);
+
+	const glm::quat inverseParentRotation = glm::inverse(parentRotation);
+
+	transform->setPosition((inverseParentRotation * (globalPosition - parentPosition)) / parentScale);
+	transform->setRotation(inverseParentRotation * globalRotation);
+}
+
+ColliderMotionState::ColliderMotionState(Collider* collider) : 
+	collider(collider),
+	currentTransform(btTransform::getIdentity()) {
+
+	if (collider->self.valid() && collider->self.has_component<Transform>())
+		transform = collider->self.component<Transform>().get();
+
+	collider->getWorldTransform(currentTransform);
+	previousTransform = currentTransform;
+
+	if (transform)
+		syncedVersion = transform->version();
+}
+
+void ColliderMotionState::getWorldTransform(btTransform& worldTransform) const {
+	worldTransform = currentTransform * centerOfMassOffset;
+}
+
+void ColliderMotionState::setWorldTransform(const btTransform& worldTransform) {
+	// Physics::update writes the fixed step states through interpolate() instead of bullet's extrapolated transform
+}
+
+void ColliderMotionState::interpolate(btScalar alpha) {
+	interpolate(previousTransform, currentTransform, alpha);
+}
+
+void ColliderMotionState::interpolate(const btTransform& from, const btTransform& to, btScalar alpha) {
+	if (!transform)
+		return;
+
+	const btVector3 position = from.getOrigin().lerp(to.getOrigin(), alpha);
+	const btQuaternion rotation = from.getRotation().slerp(to.getRotation(), alpha);
+
+	// parented bodies go through the parent's space
+	if (transform->parent().valid()) {
+		collider->setWorldTransform(btTransform(rotation, position));
+		return;
+	}
+
+	transform->setPosition(fromBt(position));
+	transform->setRotation(fromBt(rotation));
 }
@@ -7,11 +7,14 @@
 #include <LinearMath\btMotionState.h>
 #include <btBulletDynamicsCommon.h>
 
-#include <optional>
-#include <variant>
+#include <string>
 
 #include "component\Transform.hpp"
 
+class Hierarchy;
+class Physics;
+class btPairCachingGhostObject;
+
 inline glm::quat fromBt(const btQuaternion& from) {
 	return glm::quat(from.w(), from.x(), from.y(), from.z());
 }
@@ -28,30 +31,23 @@ inline btVector3 toBt(const glm::vec3& from) {
 	return btVector3(from.x, from.y, from.z);
 }
 
-struct Collider : public btMotionState {
+struct Collider {
 	enum ShapeType {
 		Sphere, // a = diameter
 		Box, // a = width, b = height, c = depth
 		Cylinder, // a = diameter, b = height
 		Capsule, // a = diameter, b = height
 		Cone, // a = diameter, b = height
-		Plane
+		Plane,
+		Mesh, // meshFile and meshIndex like Model, static bodies only
+		ConvexMesh // meshFile and meshIndex like Model, decomposed into at most maxHulls hulls
 	};
 
-	using ShapeVariant = std::variant<
-		btSphereShape,
-		btBoxShape,
-		btCylinderShapeZ,
-		btCapsuleShapeZ,
-		btConeShapeZ,
-		btStaticPlaneShape
-	>;
-
 	enum BodyType {
 		Solid,
-		Trigger,
+		Trigger, // ghost object following its Transform, reports overlaps through Physics' trigger queries
 		Static,
-		StaticTrigger,
+		StaticTrigger, // ghost object that never moves
 		Kinematic
 	};
 
@@ -62,14 +58,25 @@ struct Collider : public btMotionState {
 		float b = 1.f;
 		float c = 1.f;
 		float d = 1.f;
+
+		std::string meshFile = "";
+		uint32_t meshIndex = 0;
+
+		uint32_t maxHulls = 16;
+		uint32_t maxHullVertices = 32;
 	};
 
 	struct BodyInfo {
 		BodyType type = Solid;
 		float mass = 0.f;
 
+		// one of Physics' collision layers, decides which other bodies it pairs with
+		// left empty, triggers go on "trigger" when Physics has one and everything else on the first layer
+		std::string layer;
+
 		bool alwaysActive = false;
-		bool callbacks = false;
+		bool callbacks = false; // list this body's contacts in the contact stream
+		float contactImpulseThreshold = 0.f; // contacts with less combined impulse are left out for this body
 
 		glm::vec3 defaultLinearFactor = { 1, 1, 1 };
 		glm::vec3 defaultAngularFactor = { 1, 1, 1 };
@@ -77,7 +84,7 @@ struct Collider : public btMotionState {
 		glm::vec3 startingLinearVelocity;
 		glm::vec3 startingAngularVelocity;
 
-		glm::vec3 centerOfMass;
+		glm::vec3 centerOfMass; // offset from the collider's origin along its axes, scaled with it, moving bodies only
 
 		float defaultRollingFriction = 0.5f;
 		float defaultSpinningFriction = 0.5f;
@@ -94,20 +101,28 @@ struct Collider : public btMotionState {
 	};
 
 	entityx::Entity self;
+	const Hierarchy* hierarchy = nullptr;
+	Physics* physics = nullptr; // body changes go through its commands, applied before its next step when threaded
 
 	const ShapeInfo shapeInfo;
 	const BodyInfo bodyInfo;
 
-	ShapeVariant shapeVariant;
-	btRigidBody rigidBody;
-	
-protected:
-	void getWorldTransform(btTransform& worldTransform) const final;
-	void setWorldTransform(const btTransform& worldTransform) final;
+	btCollisionShape* shape = nullptr; // shared with matching colliders, owned by Physics
+	btRigidBody* rigidBody = nullptr; // pooled with its motion state, owned by Physics
+	btPairCachingGhostObject* ghostObject = nullptr; // in place of rigidBody for triggers, owned by Physics
+	// set when merged into the nearest ancestor's body, rigidBody is then the root's and its type and layer apply
+	// parts keep the local transform they had when added
+	Collider* compoundRoot = nullptr;
+	uint8_t layer = 0; // index of the collision layer, changed through Physics::setLayer
 
-public:
 	Collider(ShapeInfo shapeInfo, BodyInfo bodyInfo = BodyInfo());
 
+	// global transform read through the hierarchy
+	void getWorldTransform(btTransform& worldTransform) const;
+	// writes a global transform to the Transform, through the parent's space if it has one
+	void setWorldTransform(const btTransform& worldTransform);
+
+	// body changes are ignored and reads are zero for triggers, they have no rigidBody
 	void setActive(bool active);
 	void setAlwaysActive(bool alwaysActive);
 	void setLinearVelocity(const glm::vec3& velocity);
@@ -125,4 +140,41 @@ public:
 
 	void applyForce(const glm::vec3& force);
 	void applyImpulse(const glm::vec3 impulse);
+};
+
+// Motion state of a collider's body, keeps the transforms after the last two fixed steps for interpolation
+struct ColliderMotionState : public btMotionState {
+	Collider* collider;
+	Transform* transform = nullptr; // cached at creation, cleared by Physics if the Transform is removed first
+
+	btTransform previousTransform;
+	btTransform currentTransform; // kinematic bodies read this, pushed from the Transform when its version changes
+
+	// body's frame in the collider's, the centre of mass of a compound or an off centre body, set by Physics
+	// the transforms above are the collider's, bullet gets and gives the body's through this
+	btTransform centerOfMassOffset = btTransform::getIdentity();
+
+	uint8_t lodTier = 0; // index into Physics' lod tiers
+
+	uint32_t syncedVersion = 0; // Transform version last pushed, kinematic bodies only
+	uint32_t kinematicSlot = 0; // position in Physics' kinematic list
+	uint32_t movedSlot = 0; // position in Physics' moved list when moved is set
+	bool moved = false;
+	bool settled = false; // sleeping with previousTransform == currentTransform, skipped by the sync stages
+
+	// velocities as of the last sync, what Collider reads back when Physics is threaded
+	btVector3 syncedLinearVelocity = btVector3(0, 0, 0);
+	btVector3 syncedAngularVelocity = btVector3(0, 0, 0);
+
+	// reads the starting transform through the collider's hierarchy
+	ColliderMotionState(Collider* collider);
+
+	void getWorldTransform(btTransform& worldTransform) const override;
+	// bullet calls this for every awake body after stepping, Physics lists the ones it woke from here
+	void setWorldTransform(const btTransform& worldTransform) override;
+
+	// writes previousTransform blended towards currentTransform by alpha to the cached Transform
+	void interpolate(btScalar alpha);
+	// same from a copy of two fixed step states, the threaded sync interpolates its own
+	void interpolate(const btTransform& from, const btTransform& to, btScalar alpha);
 };
\ No newline at end of file
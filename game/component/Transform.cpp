@@ -1,8 +1,13 @@
 #include "component\Transform.hpp"
 
+#include "other\Trs.hpp"
+
 #include <glm\gtc\matrix_transform.hpp>
 #include <glm\gtx\matrix_decompose.hpp>
 
+#include <vector>
+#include <iostream>
+
 const glm::vec3 Transform::up(0, 0, 1);
 const glm::vec3 Transform::down(0, 0, -1);
 const glm::vec3 Transform::left(-1, 0, 0);
@@ -10,35 +15,106 @@ const glm::vec3 Transform::right(1, 0, 0);
 const glm::vec3 Transform::forward(0, 1, 0);
 const glm::vec3 Transform::back(0, -1, 0);
 
+const glm::vec3& Transform::position() const {
+	return _position;
+}
+
+const glm::quat& Transform::rotation() const {
+	return _rotation;
+}
+
+const glm::vec3& Transform::scale() const {
+	return _scale;
+}
+
+void Transform::setPosition(const glm::vec3& position) {
+	_position = position;
+	_markDirty();
+}
+
+void Transform::setRotation(const glm::quat& rotation) {
+	_rotation = rotation;
+	_markDirty();
+}
+
+void Transform::setScale(const glm::vec3& scale) {
+	_scale = scale;
+	_markDirty();
+}
+
 glm::mat4 Transform::localMatrix() const {
 	glm::mat4 matrix;
-
-	matrix = glm::translate(matrix, position);
-	matrix *= glm::mat4_cast(rotation);
-	matrix = glm::scale(matrix, scale);
+	composeTrs(&_position, &_rotation, &_scale, &matrix, 1);
 
 	return matrix;
 }
 
-glm::mat4 Transform::globalMatrix() const {
-	glm::mat4 matrix;
+const Transform* Transform::_parentTransform() const {
+	if (_parent.valid() && _parent.has_component<Transform>())
+		return _parent.component<const Transform>().get();
 
-	const Transform* transform = this;
-	
-	do {
-		matrix = transform->localMatrix() * matrix;
-	
-		if (transform->parent.valid() && transform->parent.has_component<Transform>())
-			transform = transform->parent.component<const Transform>().get();
-		else
-			transform = nullptr;
-	
-	} while (transform);
+	return nullptr;
+}
 
-	return matrix;
+void Transform::_markDirty() {
+	if (_dirty)
+		return;
+
+	_dirty = true;
+
+	for (entityx::Entity child = _firstChild; child.valid(); ) {
+		auto childTransform = child.component<Transform>();
+		childTransform->_markDirty();
+
+		child = childTransform->_nextSibling;
+	}
 }
 
-void Transform::globalDecomposed(glm::vec3* position, glm::quat* rotation, glm::vec3* scale) const {
+void Transform::_refresh() const {
+	if (!_dirty)
+		return;
+
+	// a clean parent returns straight away, a dirty one brings its own chain up to date
+	const Transform* parentTransform = _parentTransform();
+
+	if (parentTransform) {
+		parentTransform->_refresh();
+
+		_globalMatrix = parentTransform->_globalMatrix * localMatrix();
+
+		const bool composed = composeTrsChild(
+			parentTransform->_globalPosition, parentTransform->_globalRotation, parentTransform->_globalScale,
+			_position, _rotation, _scale,
+			&_globalPosition, &_globalRotation, &_globalScale);
+
+		_sheared = parentTransform->_sheared || !composed;
+	}
+	else {
+		_globalMatrix = localMatrix();
+
+		_globalPosition = _position;
+		_globalRotation = _rotation;
+		_globalScale = _scale;
+		_sheared = false;
+	}
+
+	_version++;
+	_dirty = false;
+}
+
+const glm::mat4& Transform::globalMatrix() const {
+	_refresh();
+
+	return _globalMatrix;
+}
+
+uint32_t Transform::version() const {
+	_refresh();
+
+	return _version;
+}
+
+void Transform::decompose(const glm::mat4& matrix, glm::vec3* position, glm::quat* rotation, glm::vec3* scale) {
 	glm::vec3 tempPosition;
 	glm::quat tempRotation;
 	glm::vec3 tempScale;
@@ -50,40 +126,203 @@ void Transform::globalDecomposed(glm::vec3* position, glm::quat* rotation, glm::
 	if (!scale)
 		scale = &tempScale;
 	
-	glm::decompose(globalMatrix(), *scale, *rotation, *position, glm::vec3(), glm::vec4());
+	glm::decompose(matrix, *scale, *rotation, *position, glm::vec3(), glm::vec4());
 
 	*rotation = glm::inverse(*rotation); // not sure why, goes crazy without???
 }
 
+void Transform::globalDecomposed(glm::vec3* position, glm::quat* rotation, glm::vec3* scale) const {
+	_refresh();
+
+	if (_sheared) {
+		decompose(_globalMatrix, position, rotation, scale);
+		return;
+	}
+
+	if (position)
+		*position = _globalPosition;
+	if (rotation)
+		*rotation = _globalRotation;
+	if (scale)
+		*scale = _globalScale;
+}
+
 void Transform::localRotate(const glm::quat& rotate) {
-	rotation = rotation * rotate;
+	setRotation(_rotation * rotate);
 }
 
 void Transform::localTranslate(const glm::vec3& translation) {
-	position = position + rotation * translation;
+	setPosition(_position + _rotation * translation);
 }
 
 void Transform::localScale(const glm::vec3 & scaling) {
-	scale = scale * scaling;
+	setScale(_scale * scaling);
 }
 
 void Transform::globalRotate(const glm::quat& rotate) {
 	//if (!parent)
-	rotation = rotate * rotation;
+	setRotation(rotate * _rotation);
 	//else
 	//	_setRotation(glm::inverse(parent->worldRotation()) * (rotation * worldRotation()));
 }
 
 void Transform::globalTranslate(const glm::vec3& translation) {
 	//if (!parent)
-	position = position + translation;
+	setPosition(_position + translation);
 	//else
 	//	_setPosition(_position + glm::inverse(parent->worldRotation()) * translation);
 }
 
 void Transform::globalScale(const glm::vec3 & scaling) {
 	//if (!parent)
-	scale = scale * scaling;
+	setScale(_scale * scaling);
 	//else
 	//	_setScale(scaling / parent->worldScale());
-}
\ No newline at end of file
+}
+
+void Transform::setParent(entityx::Entity self, entityx::Entity newParent) {
+	// the parent's child list lives in its Transform, without one this child would miss its dirty flags
+	if (newParent.valid() && !newParent.has_component<Transform>()) {
+		std::cerr << "Transform: can't parent an entity to one without a Transform" << std::endl;
+		return;
+	}
+
+	// walking up from the new parent must never reach self, or subtree walks would loop forever
+	for (entityx::Entity ancestor = newParent; ancestor.valid() && ancestor.has_component<Transform>(); ancestor = ancestor.component<Transform>()->_parent) {
+		if (ancestor == self) {
+			std::cerr << "Transform: can't parent an entity to itself or its descendants" << std::endl;
+			return;
+		}
+	}
+
+	_parent = newParent;
+	_link(self, newParent);
+}
+
+entityx::Entity Transform::parent() const {
+	return _parent;
+}
+
+entityx::Entity Transform::firstChild() const {
+	return _firstChild;
+}
+
+entityx::Entity Transform::nextSibling() const {
+	return _nextSibling;
+}
+
+void Transform::_link(entityx::Entity self, entityx::Entity newParent) {
+	_unlink();
+	_markDirty();
+
+	if (!newParent.valid() || !newParent.has_component<Transform>())
+		return;
+
+	auto parentTransform = newParent.component<Transform>();
+
+	_linkedParent = newParent;
+	_nextSibling = parentTransform->_firstChild;
+
+	if (_nextSibling.valid())
+		_nextSibling.component<Transform>()->_previousSibling = self;
+
+	parentTransform->_firstChild = self;
+}
+
+void Transform::_unlink() {
+	if (_previousSibling.valid())
+		_previousSibling.component<Transform>()->_nextSibling = _nextSibling;
+	else if (_linkedParent.valid() && _linkedParent.has_component<Transform>())
+		_linkedParent.component<Transform>()->_firstChild = _nextSibling;
+
+	if (_nextSibling.valid())
+		_nextSibling.component<Transform>()->_previousSibling = _previousSibling;
+
+	_linkedParent = entityx::Entity();
+	_nextSibling = entityx::Entity();
+	_previousSibling = entityx::Entity();
+}
+
+void Transform::_unlinkChildren() {
+	entityx::Entity child = _firstChild;
+
+	while (child.valid()) {
+		auto childTransform = child.component<Transform>();
+		child = childTransform->_nextSibling;
+
+		childTransform->_linkedParent = entityx::Entity();
+		childTransform->_nextSibling = entityx::Entity();
+		childTransform->_previousSibling = entityx::Entity();
+
+		// the parent's matrix is going away
+		childTransform->_markDirty();
+	}
+
+	_firstChild = entityx::Entity();
+}
+
+Transform::SubtreeIterator::SubtreeIterator(entityx::Entity root, entityx::Entity current) : 
+	_root(root), 
+	_current(current) {
+}
+
+entityx::Entity Transform::SubtreeIterator::operator*() const {
+	return _current;
+}
+
+Transform::SubtreeIterator& Transform::SubtreeIterator::operator++() {
+	auto transform = _current.component<const Transform>();
+
+	// descend first
+	if (transform->_firstChild.valid()) {
+		_current = transform->_firstChild;
+		return *this;
+	}
+
+	// otherwise the next sibling of the closest ancestor that has one, stopping at the root
+	entityx::Entity entity = _current;
+
+	while (entity != _root) {
+		auto entityTransform = entity.component<const Transform>();
+
+		if (entityTransform->_nextSibling.valid()) {
+			_current = entityTransform->_nextSibling;
+			return *this;
+		}
+
+		entity = entityTransform->_linkedParent;
+	}
+
+	_current = entityx::Entity();
+	return *this;
+}
+
+bool Transform::SubtreeIterator::operator!=(const SubtreeIterator& other) const {
+	return _current != other._current;
+}
+
+Transform::SubtreeIterator Transform::Subtree::begin() const {
+	if (!root.valid() || !root.has_component<Transform>())
+		return end();
+
+	return SubtreeIterator(root, root);
+}
+
+Transform::SubtreeIterator Transform::Subtree::end() const {
+	return SubtreeIterator(root, entityx::Entity());
+}
+
+Transform::Subtree Transform::subtree(entityx::Entity root) {
+	return Subtree{ root };
+}
+
+void Transform::destroySubtree(entityx::Entity root) {
+	std::vector<entityx::Entity> entities;
+
+	for (entityx::Entity entity : subtree(root))
+		entities.push_back(entity);
+
+	// children before parents, so each destroy only unlinks a leaf
+	for (auto i = entities.rbegin(); i != entities.rend(); i++)
+		i->destroy();
+}
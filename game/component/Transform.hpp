@@ -6,6 +6,8 @@
 
 #include <entityx\Entity.h>
 
+class Hierarchy;
+
 struct Transform {
 	static const glm::vec3 up;
 	static const glm::vec3 down;
@@ -14,16 +16,25 @@ struct Transform {
 	static const glm::vec3 forward;
 	static const glm::vec3 back;
 
-	entityx::Entity parent;
+	static void decompose(const glm::mat4& matrix, glm::vec3* position, glm::quat* rotation = nullptr, glm::vec3* scale = nullptr);
+
+	const glm::vec3& position() const;
+	const glm::quat& rotation() const;
+	const glm::vec3& scale() const;
 
-	glm::vec3 position;
-	glm::quat rotation;
-	glm::vec3 scale = { 1, 1, 1 };
+	// each marks this transform and its descendants dirty
+	void setPosition(const glm::vec3& position);
+	void setRotation(const glm::quat& rotation);
+	void setScale(const glm::vec3& scale);
 
 	glm::mat4 localMatrix() const;
-	glm::mat4 globalMatrix() const;
+	// cached, recomputed on the first read after this transform or an ancestor changed
+	const glm::mat4& globalMatrix() const;
 	void globalDecomposed(glm::vec3* position, glm::quat* rotation = nullptr, glm::vec3* scale = nullptr) const;
 
+	// bumped every time the cached global matrix is recomputed
+	uint32_t version() const;
+
 	void localRotate(const glm::quat& rotation);
 	void localTranslate(const glm::vec3& translation);
 	void localScale(const glm::vec3 & scaling);
@@ -31,4 +42,68 @@ struct Transform {
 	void globalRotate(const glm::quat& rotation);
 	void globalTranslate(const glm::vec3& translation);
 	void globalScale(const glm::vec3 & scaling);
+
+	// relinks straight away, refused with an error if parent is self, one of its descendants or has no Transform
+	void setParent(entityx::Entity self, entityx::Entity parent);
+	entityx::Entity parent() const;
+
+	entityx::Entity firstChild() const;
+	entityx::Entity nextSibling() const;
+
+	// depth first, pre-order walk over an entity and all of its descendants
+	class SubtreeIterator {
+		entityx::Entity _root;
+		entityx::Entity _current;
+
+	public:
+		SubtreeIterator(entityx::Entity root, entityx::Entity current);
+
+		entityx::Entity operator*() const;
+		SubtreeIterator& operator++();
+		bool operator!=(const SubtreeIterator& other) const;
+	};
+
+	struct Subtree {
+		entityx::Entity root;
+
+		SubtreeIterator begin() const;
+		SubtreeIterator end() const;
+	};
+
+	static Subtree subtree(entityx::Entity root);
+	static void destroySubtree(entityx::Entity root);
+
+private:
+	entityx::Entity _parent;
+
+	glm::vec3 _position;
+	glm::quat _rotation;
+	glm::vec3 _scale = { 1, 1, 1 };
+
+	// intrusive child list, parent's _firstChild then each child's _nextSibling
+	entityx::Entity _linkedParent;
+	entityx::Entity _firstChild;
+	entityx::Entity _nextSibling;
+	entityx::Entity _previousSibling;
+
+	void _link(entityx::Entity self, entityx::Entity parent);
+	void _unlink();
+	void _unlinkChildren();
+
+	// cached global matrix and TRS, recomputed on read while dirty
+	// a dirty transform's descendants are always dirty too, so marking stops at the first one already dirty
+	mutable glm::mat4 _globalMatrix;
+	mutable glm::vec3 _globalPosition;
+	mutable glm::quat _globalRotation;
+	mutable glm::vec3 _globalScale;
+	mutable bool _sheared = false; // global TRS is unusable, decompose _globalMatrix instead
+	mutable uint32_t _version = 0;
+	mutable bool _dirty = true;
+
+	void _markDirty();
+
+	const Transform* _parentTransform() const;
+	void _refresh() const;
+
+	friend class Hierarchy;
 };
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include <new>
+#include <utility>
+#include <cassert>
+#include <cstdint>
+
+// Chunked storage for objects created and destroyed often, slots honour alignof(T) and are reused before growing
+template <class T, uint32_t ChunkSize = 256>
+class AlignedPool {
+	std::vector<T*> _chunks;
+	std::vector<T*> _free;
+	uint32_t _size = 0;
+
+	void _grow() {
+		T* chunk = (T*)::operator new(sizeof(T) * ChunkSize, std::align_val_t(alignof(T)));
+		_chunks.push_back(chunk);
+
+		// reversed, so slots are handed out in address order
+		for (uint32_t i = ChunkSize; i > 0; i--)
+			_free.push_back(chunk + i - 1);
+	}
+
+public:
+	AlignedPool() = default;
+	AlignedPool(const AlignedPool&) = delete;
+	AlignedPool& operator=(const AlignedPool&) = delete;
+
+	// objects must be destroyed before the pool
+	~AlignedPool() {
+		assert(_size == 0);
+
+		for (T* chunk : _chunks)
+			::operator delete(chunk, std::align_val_t(alignof(T)));
+	}
+
+	template <class... Args>
+	T* create(Args&&... args) {
+		if (_free.empty())
+			_grow();
+
+		T* slot = _free.back();
+		_free.pop_back();
+
+		_size++;
+
+		return ::new (slot) T(std::forward<Args>(args)...);
+	}
+
+	void destroy(T* object) {
+		object->~T();
+
+		_free.push_back(object);
+		_size--;
+	}
+
+	uint32_t size() const {
+		return _size;
+	}
+};
@@ -0,0 +1,325 @@
+#include "other\Broadphase.hpp"
+
+#include <LinearMath\btAabbUtil2.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+
+inline btVector3 toBtVector(const glm::vec3& from) {
+	return btVector3(from.x, from.y, from.z);
+}
+
+inline bool rangesOverlap(const int* aMin, const int* aMax, const int* bMin, const int* bMax) {
+	return aMin[0] <= bMax[0] && aMax[0] >= bMin[0] &&
+		aMin[1] <= bMax[1] && aMax[1] >= bMin[1] &&
+		aMin[2] <= bMax[2] && aMax[2] >= bMin[2];
+}
+
+inline uint64_t rangeCells(const int* cellMin, const int* cellMax) {
+	return (uint64_t)(cellMax[0] - cellMin[0] + 1) * (uint64_t)(cellMax[1] - cellMin[1] + 1) * (uint64_t)(cellMax[2] - cellMin[2] + 1);
+}
+
+template <class T>
+inline void swapRemove(std::vector<T>& vector, const T& value) {
+	auto i = std::find(vector.begin(), vector.end(), value);
+
+	if (i == vector.end())
+		return;
+
+	*i = vector.back();
+	vector.pop_back();
+}
+
+GridBroadphase::Proxy::Proxy(const btVector3& aabbMin, const btVector3& aabbMax, void* userPtr, int collisionFilterGroup, int collisionFilterMask) :
+	btBroadphaseProxy(aabbMin, aabbMax, userPtr, collisionFilterGroup, collisionFilterMask),
+	slot(0),
+	oversized(false),
+	moved(false) {
+}
+
+GridBroadphase::GridBroadphase(btScalar cellSize, uint32_t bucketCount, uint32_t maxProxyCells) :
+	_cellSize(cellSize),
+	_bucketMask(bucketCount - 1),
+	_maxProxyCells(maxProxyCells),
+	_buckets(bucketCount) {
+
+	assert(cellSize > 0 && bucketCount && (bucketCount & (bucketCount - 1)) == 0);
+}
+
+GridBroadphase::~GridBroadphase() {
+	for (Proxy* proxy : _proxies)
+		delete proxy;
+}
+
+void GridBroadphase::_cellRange(const btVector3& aabbMin, const btVector3& aabbMax, int* cellMin, int* cellMax) const {
+	// clamped so huge bounds (i.e. planes) don't overflow, they end up oversized anyway
+	const btScalar limit = (btScalar)(1 << 20);
+
+	for (int i = 0; i < 3; i++) {
+		cellMin[i] = (int)std::floor(btClamped(aabbMin[i] / _cellSize, -limit, limit));
+		cellMax[i] = (int)std::floor(btClamped(aabbMax[i] / _cellSize, -limit, limit));
+	}
+}
+
+uint32_t GridBroadphase::_bucket(int x, int y, int z) const {
+	return ((uint32_t)x * 73856093u ^ (uint32_t)y * 19349663u ^ (uint32_t)z * 83492791u) & _bucketMask;
+}
+
+void GridBroadphase::_insert(Proxy* proxy) {
+	_cellRange(proxy->m_aabbMin, proxy->m_aabbMax, proxy->cellMin, proxy->cellMax);
+
+	proxy->oversized = rangeCells(proxy->cellMin, proxy->cellMax) > _maxProxyCells;
+
+	if (proxy->oversized) {
+		_oversized.push_back(proxy);
+		return;
+	}
+
+	for (int x = proxy->cellMin[0]; x <= proxy->cellMax[0]; x++) {
+		for (int y = proxy->cellMin[1]; y <= proxy->cellMax[1]; y++) {
+			for (int z = proxy->cellMin[2]; z <= proxy->cellMax[2]; z++) {
+				std::vector<Proxy*>& bucket = _buckets[_bucket(x, y, z)];
+
+				// two of its own cells hashing to one bucket, listed once
+				if (bucket.empty() || bucket.back() != proxy)
+					bucket.push_back(proxy);
+			}
+		}
+	}
+}
+
+void GridBroadphase::_remove(Proxy* proxy) {
+	if (proxy->oversized) {
+		swapRemove(_oversized, proxy);
+		return;
+	}
+
+	for (int x = proxy->cellMin[0]; x <= proxy->cellMax[0]; x++) {
+		for (int y = proxy->cellMin[1]; y <= proxy->cellMax[1]; y++) {
+			for (int z = proxy->cellMin[2]; z <= proxy->cellMax[2]; z++)
+				swapRemove(_buckets[_bucket(x, y, z)], proxy);
+		}
+	}
+}
+
+void GridBroadphase::_markMoved(Proxy* proxy) {
+	if (proxy->moved)
+		return;
+
+	proxy->moved = true;
+	_moved.push_back(proxy);
+}
+
+template <class Visitor>
+void GridBroadphase::_visitRange(const int* cellMin, const int* cellMax, const Proxy* skip, Visitor&& visit) const {
+	// walking more cells than there are buckets costs more than checking every proxy
+	if (rangeCells(cellMin, cellMax) > _buckets.size()) {
+		for (Proxy* proxy : _proxies) {
+			if (proxy != skip && !proxy->oversized && rangesOverlap(cellMin, cellMax, proxy->cellMin, proxy->cellMax))
+				visit(proxy);
+		}
+
+		return;
+	}
+
+	for (int x = cellMin[0]; x <= cellMax[0]; x++) {
+		for (int y = cellMin[1]; y <= cellMax[1]; y++) {
+			for (int z = cellMin[2]; z <= cellMax[2]; z++) {
+				for (Proxy* proxy : _buckets[_bucket(x, y, z)]) {
+					if (proxy == skip)
+						continue;
+
+					// other cells hashing to the same bucket
+					if (x < proxy->cellMin[0] || x > proxy->cellMax[0] ||
+						y < proxy->cellMin[1] || y > proxy->cellMax[1] ||
+						z < proxy->cellMin[2] || z > proxy->cellMax[2])
+						continue;
+
+					// proxies spanning several cells are only visited from the first cell both ranges share
+					if (x != std::max(cellMin[0], proxy->cellMin[0]) ||
+						y != std::max(cellMin[1], proxy->cellMin[1]) ||
+						z != std::max(cellMin[2], proxy->cellMin[2]))
+						continue;
+
+					visit(proxy);
+				}
+			}
+		}
+	}
+}
+
+btBroadphaseProxy* GridBroadphase::createProxy(const btVector3& aabbMin, const btVector3& aabbMax, int shapeType, void* userPtr, int collisionFilterGroup, int collisionFilterMask, btDispatcher* dispatcher) {
+	Proxy* proxy = new Proxy(aabbMin, aabbMax, userPtr, collisionFilterGroup, collisionFilterMask);
+	proxy->m_uniqueId = _uniqueId++;
+	proxy->slot = (uint32_t)_proxies.size();
+
+	_proxies.push_back(proxy);
+
+	_insert(proxy);
+	_markMoved(proxy);
+
+	return proxy;
+}
+
+void GridBroadphase::destroyProxy(btBroadphaseProxy* broadphaseProxy, btDispatcher* dispatcher) {
+	Proxy* proxy = (Proxy*)broadphaseProxy;
+
+	_remove(proxy);
+
+	if (proxy->moved)
+		swapRemove(_moved, proxy);
+
+	_pairCache.removeOverlappingPairsContainingProxy(proxy, dispatcher);
+
+	_proxies[proxy->slot] = _proxies.back();
+	_proxies[proxy->slot]->slot = proxy->slot;
+	_proxies.pop_back();
+
+	delete proxy;
+}
+
+void GridBroadphase::setAabb(btBroadphaseProxy* broadphaseProxy, const btVector3& aabbMin, const btVector3& aabbMax, btDispatcher* dispatcher) {
+	Proxy* proxy = (Proxy*)broadphaseProxy;
+
+	// bullet refreshes every awake object's bounds each step, resting ones don't need their pairs updated
+	if (aabbMin == proxy->m_aabbMin && aabbMax == proxy->m_aabbMax)
+		return;
+
+	int cellMin[3];
+	int cellMax[3];
+	_cellRange(aabbMin, aabbMax, cellMin, cellMax);
+
+	const bool sameCells = std::equal(cellMin, cellMin + 3, proxy->cellMin) && std::equal(cellMax, cellMax + 3, proxy->cellMax);
+
+	// buckets are only touched when the body crosses into other cells
+	if (!sameCells)
+		_remove(proxy);
+
+	proxy->m_aabbMin = aabbMin;
+	proxy->m_aabbMax = aabbMax;
+
+	if (!sameCells)
+		_insert(proxy);
+
+	_markMoved(proxy);
+}
+
+void GridBroadphase::getAabb(btBroadphaseProxy* proxy, btVector3& aabbMin, btVector3& aabbMax) const {
+	aabbMin = proxy->m_aabbMin;
+	aabbMax = proxy->m_aabbMax;
+}
+
+void GridBroadphase::rayTest(const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback, const btVector3& aabbMin, const btVector3& aabbMax) {
+	// cells covered by the swept box, convex sweeps pass their shape's extents as aabbMin and aabbMax
+	btVector3 sweptMin = rayFrom;
+	btVector3 sweptMax = rayFrom;
+	sweptMin.setMin(rayTo);
+	sweptMax.setMax(rayTo);
+
+	int cellMin[3];
+	int cellMax[3];
+	_cellRange(sweptMin + aabbMin, sweptMax + aabbMax, cellMin, cellMax);
+
+	// same slab test as btDbvt's ray walk, with proxy bounds grown by the swept extents
+	auto test = [&](const Proxy* proxy) {
+		btVector3 bounds[2] = { proxy->m_aabbMin - aabbMax, proxy->m_aabbMax - aabbMin };
+		btScalar lambda;
+
+		if (btRayAabb2(rayFrom, rayCallback.m_rayDirectionInverse, rayCallback.m_signs, bounds, lambda, 0, rayCallback.m_lambda_max))
+			rayCallback.process(proxy);
+	};
+
+	_visitRange(cellMin, cellMax, nullptr, test);
+
+	for (const Proxy* proxy : _oversized)
+		test(proxy);
+}
+
+void GridBroadphase::aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback) {
+	int cellMin[3];
+	int cellMax[3];
+	_cellRange(aabbMin, aabbMax, cellMin, cellMax);
+
+	auto test = [&](const Proxy* proxy) {
+		if (TestAabbAgainstAabb2(aabbMin, aabbMax, proxy->m_aabbMin, proxy->m_aabbMax))
+			callback.process(proxy);
+	};
+
+	_visitRange(cellMin, cellMax, nullptr, test);
+
+	for (const Proxy* proxy : _oversized)
+		test(proxy);
+}
+
+void GridBroadphase::calculateOverlappingPairs(btDispatcher* dispatcher) {
+	for (Proxy* proxy : _moved) {
+		// existing pairs are found by the pair cache instead of added twice
+		auto add = [&](Proxy* other) {
+			if (TestAabbAgainstAabb2(proxy->m_aabbMin, proxy->m_aabbMax, other->m_aabbMin, other->m_aabbMax))
+				_pairCache.addOverlappingPair(proxy, other);
+		};
+
+		if (proxy->oversized) {
+			for (Proxy* other : _proxies) {
+				if (other != proxy)
+					add(other);
+			}
+
+			continue;
+		}
+
+		_visitRange(proxy->cellMin, proxy->cellMax, proxy, add);
+
+		for (Proxy* other : _oversized)
+			add(other);
+	}
+
+	// pairs of bodies that didn't move can't have separated
+	btBroadphasePairArray& pairs = _pairCache.getOverlappingPairArray();
+
+	for (int i = 0; i < pairs.size();) {
+		Proxy* first = (Proxy*)pairs[i].m_pProxy0;
+		Proxy* second = (Proxy*)pairs[i].m_pProxy1;
+
+		if ((first->moved || second->moved) && !TestAabbAgainstAabb2(first->m_aabbMin, first->m_aabbMax, second->m_aabbMin, second->m_aabbMax)) {
+			// the last pair is moved into this slot
+			_pairCache.removeOverlappingPair(first, second, dispatcher);
+			continue;
+		}
+
+		i++;
+	}
+
+	for (Proxy* proxy : _moved)
+		proxy->moved = false;
+
+	_moved.clear();
+}
+
+btOverlappingPairCache* GridBroadphase::getOverlappingPairCache() {
+	return &_pairCache;
+}
+
+const btOverlappingPairCache* GridBroadphase::getOverlappingPairCache() const {
+	return &_pairCache;
+}
+
+void GridBroadphase::getBroadphaseAabb(btVector3& aabbMin, btVector3& aabbMax) const {
+	aabbMin.setValue(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+	aabbMax.setValue(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT);
+}
+
+void GridBroadphase::printStats() {
+}
+
+std::unique_ptr<btBroadphaseInterface> createBroadphase(const BroadphaseInfo& broadphaseInfo) {
+	switch (broadphaseInfo.type) {
+	case BroadphaseInfo::AxisSweep:
+		return std::make_unique<bt32BitAxisSweep3>(toBtVector(broadphaseInfo.worldMin), toBtVector(broadphaseInfo.worldMax), broadphaseInfo.maxHandles);
+	case BroadphaseInfo::Grid:
+		return std::make_unique<GridBroadphase>(broadphaseInfo.cellSize, broadphaseInfo.bucketCount, broadphaseInfo.maxProxyCells);
+	default:
+		return std::make_unique<btDbvtBroadphase>();
+	}
+}
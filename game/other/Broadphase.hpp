@@ -0,0 +1,88 @@
+#pragma once
+
+#include <btBulletCollisionCommon.h>
+
+#include <glm\vec3.hpp>
+
+#include <vector>
+#include <memory>
+
+struct BroadphaseInfo {
+	enum Type {
+		Dbvt, // dynamic aabb trees, no bounds, good all round
+		AxisSweep, // sort and sweep inside fixed bounds, suits many slow bodies spread over the bounds
+		Grid // hashed uniform grid, suits similar sized bodies at an even density
+	};
+
+	Type type = Dbvt;
+
+	// axis sweep only, bodies outside are clamped to the edge
+	glm::vec3 worldMin = { -100000.f, -100000.f, -100000.f };
+	glm::vec3 worldMax = { 100000.f, 100000.f, 100000.f };
+	uint32_t maxHandles = 65536;
+
+	// grid only, around the size of a typical body
+	float cellSize = 200.f;
+	uint32_t bucketCount = 65536; // power of two, cells hash into these
+	uint32_t maxProxyCells = 64; // bodies spanning more cells are tested against everything instead
+};
+
+// Spatial hash of fixed size cells, bodies are listed in every cell their aabb touches
+class GridBroadphase : public btBroadphaseInterface {
+	struct Proxy : public btBroadphaseProxy {
+		int cellMin[3];
+		int cellMax[3];
+		uint32_t slot; // in _proxies
+		bool oversized;
+		bool moved;
+
+		Proxy(const btVector3& aabbMin, const btVector3& aabbMax, void* userPtr, int collisionFilterGroup, int collisionFilterMask);
+	};
+
+	const btScalar _cellSize;
+	const uint32_t _bucketMask;
+	const uint32_t _maxProxyCells;
+
+	btHashedOverlappingPairCache _pairCache;
+
+	std::vector<std::vector<Proxy*>> _buckets;
+	std::vector<Proxy*> _proxies;
+	std::vector<Proxy*> _oversized; // too big for the grid
+	std::vector<Proxy*> _moved; // since the last pair update
+
+	int _uniqueId = 2; // 0 and 1 are reserved by bullet
+
+	void _cellRange(const btVector3& aabbMin, const btVector3& aabbMax, int* cellMin, int* cellMax) const;
+	uint32_t _bucket(int x, int y, int z) const;
+
+	void _insert(Proxy* proxy);
+	void _remove(Proxy* proxy);
+	void _markMoved(Proxy* proxy);
+
+	// calls visit once for each proxy whose cells overlap the range, listed in the first cell both share
+	template <class Visitor>
+	void _visitRange(const int* cellMin, const int* cellMax, const Proxy* skip, Visitor&& visit) const;
+
+public:
+	GridBroadphase(btScalar cellSize, uint32_t bucketCount, uint32_t maxProxyCells);
+	~GridBroadphase();
+
+	btBroadphaseProxy* createProxy(const btVector3& aabbMin, const btVector3& aabbMax, int shapeType, void* userPtr, int collisionFilterGroup, int collisionFilterMask, btDispatcher* dispatcher) final;
+	void destroyProxy(btBroadphaseProxy* proxy, btDispatcher* dispatcher) final;
+	void setAabb(btBroadphaseProxy* proxy, const btVector3& aabbMin, const btVector3& aabbMax, btDispatcher* dispatcher) final;
+	void getAabb(btBroadphaseProxy* proxy, btVector3& aabbMin, btVector3& aabbMax) const final;
+
+	void rayTest(const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback, const btVector3& aabbMin = btVector3(0, 0, 0), const btVector3& aabbMax = btVector3(0, 0, 0)) final;
+	void aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback) final;
+
+	// pairs are only added and removed around proxies that moved since the last call
+	void calculateOverlappingPairs(btDispatcher* dispatcher) final;
+
+	btOverlappingPairCache* getOverlappingPairCache() final;
+	const btOverlappingPairCache* getOverlappingPairCache() const final;
+
+	void getBroadphaseAabb(btVector3& aabbMin, btVector3& aabbMax) const final;
+	void printStats() final;
+};
+
+std::unique_ptr<btBroadphaseInterface> createBroadphase(const BroadphaseInfo& broadphaseInfo);
@@ -0,0 +1,90 @@
+#include "other\ContactStream.hpp"
+
+#include <algorithm>
+
+template <class T>
+void ContactStream::Buffer<T>::clear() {
+	events.clear();
+	owners.clear();
+	grouped.clear();
+	ranges.clear();
+}
+
+template <class T>
+void ContactStream::Buffer<T>::add(const T& event, bool firstListed, bool secondListed) {
+	const uint32_t index = (uint32_t)events.size();
+	events.push_back(event);
+
+	if (firstListed)
+		owners.push_back({ event.firstEntity.id().id(), index });
+
+	if (secondListed && event.secondEntity != event.firstEntity)
+		owners.push_back({ event.secondEntity.id().id(), index });
+}
+
+template <class T>
+void ContactStream::Buffer<T>::build() {
+	// keeps events in stream order within each entity
+	std::sort(owners.begin(), owners.end(), [](const Owner& a, const Owner& b) {
+		return a.id < b.id || (a.id == b.id && a.event < b.event);
+	});
+
+	grouped.resize(owners.size());
+
+	for (uint32_t i = 0; i < owners.size(); i++) {
+		grouped[i] = &events[owners[i].event];
+
+		Range& range = ranges[owners[i].id];
+
+		if (range.count == 0)
+			range.begin = i;
+
+		range.count++;
+	}
+}
+
+template <class T>
+ContactStream::Span<T> ContactStream::Buffer<T>::of(entityx::Entity entity) const {
+	auto found = ranges.find(entity.id().id());
+
+	if (found == ranges.end())
+		return Span<T>();
+
+	const T* const* first = grouped.data() + found->second.begin;
+
+	return Span<T>{ first, first + found->second.count };
+}
+
+void ContactStream::clear() {
+	_contacts.clear();
+	_colliding.clear();
+}
+
+void ContactStream::addContact(const ContactEvent& contactEvent, bool firstListed, bool secondListed) {
+	_contacts.add(contactEvent, firstListed, secondListed);
+}
+
+void ContactStream::addColliding(const CollidingEvent& collidingEvent, bool firstListed, bool secondListed) {
+	_colliding.add(collidingEvent, firstListed, secondListed);
+}
+
+void ContactStream::build() {
+	_contacts.build();
+	_colliding.build();
+}
+
+const std::vector<ContactEvent>& ContactStream::contacts() const {
+	return _contacts.events;
+}
+
+const std::vector<CollidingEvent>& ContactStream::colliding() const {
+	return _colliding.events;
+}
+
+ContactStream::Span<ContactEvent> ContactStream::contacts(entityx::Entity entity) const {
+	return _contacts.of(entity);
+}
+
+ContactStream::Span<CollidingEvent> ContactStream::colliding(entityx::Entity entity) const {
+	return _colliding.of(entity);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <entityx\Entity.h>
+
+#include <vector>
+#include <unordered_map>
+
+#include "system\PhysicsEvents.hpp"
+
+// Contacts of one physics update in contiguous buffers, grouped per subscribed entity so consumers skip the rest
+class ContactStream {
+public:
+	template <class T>
+	struct Span {
+		const T* const* first = nullptr;
+		const T* const* last = nullptr;
+
+		const T* const* begin() const { return first; }
+		const T* const* end() const { return last; }
+		uint32_t size() const { return (uint32_t)(last - first); }
+	};
+
+private:
+	struct Range {
+		uint32_t begin = 0;
+		uint32_t count = 0;
+	};
+
+	struct Owner {
+		uint64_t id;
+		uint32_t event;
+	};
+
+	template <class T>
+	struct Buffer {
+		std::vector<T> events;
+		std::vector<Owner> owners; // which subscribed entity each event is listed for
+		std::vector<const T*> grouped;
+		std::unordered_map<uint64_t, Range> ranges; // by entity id
+
+		void clear();
+		void add(const T& event, bool firstListed, bool secondListed);
+		void build();
+		Span<T> of(entityx::Entity entity) const;
+	};
+
+	Buffer<ContactEvent> _contacts;
+	Buffer<CollidingEvent> _colliding;
+
+public:
+	void clear();
+
+	// listed flags pick which of the two entities gets the event in its per-entity span
+	void addContact(const ContactEvent& contactEvent, bool firstListed, bool secondListed);
+	void addColliding(const CollidingEvent& collidingEvent, bool firstListed, bool secondListed);
+
+	// groups the events per entity, call after adding
+	void build();
+
+	const std::vector<ContactEvent>& contacts() const;
+	const std::vector<CollidingEvent>& colliding() const;
+
+	Span<ContactEvent> contacts(entityx::Entity entity) const;
+	Span<CollidingEvent> colliding(entityx::Entity entity) const;
+};
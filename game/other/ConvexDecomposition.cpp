@@ -0,0 +1,208 @@
+#include "other\ConvexDecomposition.hpp"
+
+#include <LinearMath\btConvexHullComputer.h>
+
+#include <algorithm>
+
+struct Part {
+	std::vector<uint32_t> triangles;
+	btScalar concavity = 0;
+	btAlignedObjectArray<btVector3> hull;
+};
+
+inline btVector3 vertexOf(const btScalar* vertices, int index) {
+	return btVector3(vertices[index * 3], vertices[index * 3 + 1], vertices[index * 3 + 2]);
+}
+
+inline btVector3 centroidOf(const btScalar* vertices, const int* indices, uint32_t triangle) {
+	return (vertexOf(vertices, indices[triangle * 3]) + vertexOf(vertices, indices[triangle * 3 + 1]) + vertexOf(vertices, indices[triangle * 3 + 2])) / 3;
+}
+
+// hull of the part's triangles and how deep the deepest triangle centroid sits inside it
+void evaluatePart(const btScalar* vertices, const int* indices, Part* part) {
+	std::vector<btScalar> points;
+	points.reserve(part->triangles.size() * 9);
+
+	for (uint32_t triangle : part->triangles)
+		for (uint32_t i = 0; i < 3; i++)
+			for (uint32_t j = 0; j < 3; j++)
+				points.push_back(vertices[indices[triangle * 3 + i] * 3 + j]);
+
+	btConvexHullComputer computer;
+	computer.compute(points.data(), 3 * sizeof(btScalar), (int)points.size() / 3, 0, 0);
+
+	part->hull.clear();
+	part->concavity = 0;
+
+	btVector3 center(0, 0, 0);
+
+	for (int i = 0; i < computer.vertices.size(); i++) {
+		part->hull.push_back(computer.vertices[i]);
+		center += computer.vertices[i];
+	}
+
+	// a single triangle can't be split further
+	if (computer.vertices.size() < 4 || part->triangles.size() < 2)
+		return;
+
+	center /= (btScalar)computer.vertices.size();
+
+	struct Plane {
+		btVector3 normal;
+		btScalar offset;
+	};
+
+	// inward facing planes, orientation fixed against the hull center
+	std::vector<Plane> planes;
+	planes.reserve(computer.faces.size());
+
+	for (int i = 0; i < computer.faces.size(); i++) {
+		const btConvexHullComputer::Edge* edge = &computer.edges[computer.faces[i]];
+		const btConvexHullComputer::Edge* next = edge->getNextEdgeOfFace();
+
+		const btVector3& a = computer.vertices[edge->getSourceVertex()];
+		const btVector3& b = computer.vertices[edge->getTargetVertex()];
+		const btVector3& c = computer.vertices[next->getTargetVertex()];
+
+		btVector3 normal = (b - a).cross(c - a);
+
+		if (normal.length2() < SIMD_EPSILON)
+			continue;
+
+		normal.normalize();
+
+		if (normal.dot(center - a) < 0)
+			normal = -normal;
+
+		planes.push_back({ normal, -normal.dot(a) });
+	}
+
+	for (uint32_t triangle : part->triangles) {
+		const btVector3 centroid = centroidOf(vertices, indices, triangle);
+
+		btScalar depth = BT_LARGE_FLOAT;
+
+		for (const Plane& plane : planes)
+			depth = std::min(depth, plane.normal.dot(centroid) + plane.offset);
+
+		part->concavity = std::max(part->concavity, depth);
+	}
+}
+
+void splitPart(const btScalar* vertices, const int* indices, const Part& part, Part* first, Part* second) {
+	btVector3 minimum(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT);
+	btVector3 maximum(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+	btVector3 mean(0, 0, 0);
+
+	for (uint32_t triangle : part.triangles) {
+		const btVector3 centroid = centroidOf(vertices, indices, triangle);
+
+		minimum.setMin(centroid);
+		maximum.setMax(centroid);
+		mean += centroid;
+	}
+
+	mean /= (btScalar)part.triangles.size();
+
+	const int axis = (maximum - minimum).maxAxis();
+
+	for (uint32_t triangle : part.triangles)
+		(centroidOf(vertices, indices, triangle)[axis] < mean[axis] ? first : second)->triangles.push_back(triangle);
+
+	// lopsided parts fall back to a median split
+	if (first->triangles.empty() || second->triangles.empty()) {
+		std::vector<uint32_t> triangles = part.triangles;
+		auto middle = triangles.begin() + triangles.size() / 2;
+
+		std::nth_element(triangles.begin(), middle, triangles.end(), [&](uint32_t a, uint32_t b) {
+			return centroidOf(vertices, indices, a)[axis] < centroidOf(vertices, indices, b)[axis];
+		});
+
+		first->triangles.assign(triangles.begin(), middle);
+		second->triangles.assign(middle, triangles.end());
+	}
+}
+
+// keeps the maxVertices points spreading the hull the most, first the one furthest from the center
+void reduceHull(btAlignedObjectArray<btVector3>* hull, uint32_t maxVertices) {
+	if ((uint32_t)hull->size() <= maxVertices)
+		return;
+
+	btVector3 center(0, 0, 0);
+
+	for (int i = 0; i < hull->size(); i++)
+		center += (*hull)[i];
+
+	center /= (btScalar)hull->size();
+
+	std::vector<btScalar> distances(hull->size());
+
+	for (int i = 0; i < hull->size(); i++)
+		distances[i] = (*hull)[i].distance2(center);
+
+	btAlignedObjectArray<btVector3> reduced;
+
+	while ((uint32_t)reduced.size() < maxVertices) {
+		const int furthest = (int)(std::max_element(distances.begin(), distances.end()) - distances.begin());
+		const btVector3 picked = (*hull)[furthest];
+
+		reduced.push_back(picked);
+
+		for (int i = 0; i < hull->size(); i++)
+			distances[i] = std::min(distances[i], (*hull)[i].distance2(picked));
+	}
+
+	*hull = reduced;
+}
+
+void decomposeConvex(const btScalar* vertices, uint32_t vertexCount, const int* indices, uint32_t indexCount, const ConvexDecompositionInfo& info, ConvexHulls* hulls) {
+	hulls->clear();
+
+	if (vertexCount == 0 || indexCount < 3)
+		return;
+
+	btVector3 minimum(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT);
+	btVector3 maximum(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+
+	for (uint32_t i = 0; i < vertexCount; i++) {
+		minimum.setMin(vertexOf(vertices, i));
+		maximum.setMax(vertexOf(vertices, i));
+	}
+
+	const btScalar tolerance = info.concavity * (maximum - minimum).length();
+
+	std::vector<Part> parts(1);
+	parts[0].triangles.resize(indexCount / 3);
+
+	for (uint32_t i = 0; i < parts[0].triangles.size(); i++)
+		parts[0].triangles[i] = i;
+
+	evaluatePart(vertices, indices, &parts[0]);
+
+	while (parts.size() < std::max(info.maxHulls, 1u)) {
+		auto worst = std::max_element(parts.begin(), parts.end(), [](const Part& a, const Part& b) {
+			return a.concavity < b.concavity;
+		});
+
+		if (worst->concavity <= tolerance)
+			break;
+
+		Part first, second;
+		splitPart(vertices, indices, *worst, &first, &second);
+
+		evaluatePart(vertices, indices, &first);
+		evaluatePart(vertices, indices, &second);
+
+		*worst = std::move(first);
+		parts.push_back(std::move(second));
+	}
+
+	for (Part& part : parts) {
+		// flat parts are kept, the collision margin gives them thickness
+		if (part.hull.size() < 3)
+			continue;
+
+		reduceHull(&part.hull, std::max(info.maxHullVertices, 4u));
+		hulls->push_back(part.hull);
+	}
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <LinearMath\btVector3.h>
+#include <LinearMath\btAlignedObjectArray.h>
+
+#include <vector>
+#include <cstdint>
+
+struct ConvexDecompositionInfo {
+	uint32_t maxHulls = 16;
+	uint32_t maxHullVertices = 32;
+	float concavity = 0.02f; // accepted depth of a part's triangles inside its hull, relative to the mesh diagonal
+};
+
+using ConvexHulls = std::vector<btAlignedObjectArray<btVector3>>;
+
+// Splits a triangle mesh into at most maxHulls convex point sets. The most concave part is split through its
+// triangle centroids along its longest axis until every part is within the concavity or the hull budget is spent.
+void decomposeConvex(const btScalar* vertices, uint32_t vertexCount, const int* indices, uint32_t indexCount, const ConvexDecompositionInfo& info, ConvexHulls* hulls);
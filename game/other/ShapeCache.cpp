@@ -0,0 +1,109 @@
+#include "other\ShapeCache.hpp"
+
+#include <tuple>
+
+bool ShapeCache::Key::operator<(const Key& other) const {
+	return std::tie(type, a, b, c, d, meshIndex, maxHulls, maxHullVertices, scale.x, scale.y, scale.z, meshFile) <
+		std::tie(other.type, other.a, other.b, other.c, other.d, other.meshIndex, other.maxHulls, other.maxHullVertices, other.scale.x, other.scale.y, other.scale.z, other.meshFile);
+}
+
+ShapeCache::ShapeCache(const std::string& path) : _meshLoader(path) {
+}
+
+ShapeCache::Entry::Entry() : shape(0) {
+}
+
+btCollisionShape* ShapeCache::acquire(const Collider::ShapeInfo& shapeInfo, const glm::vec3& scale) {
+	// planes ignore scaling
+	Key key{ shapeInfo.type, shapeInfo.a, shapeInfo.b, shapeInfo.c, shapeInfo.d, shapeInfo.meshFile, shapeInfo.meshIndex, shapeInfo.maxHulls, shapeInfo.maxHullVertices, shapeInfo.type == Collider::Plane ? glm::vec3(1.f) : scale };
+
+	auto found = _entries.find(key);
+
+	if (found == _entries.end()) {
+		// built in place, compound shapes can't be copied
+		found = _entries.emplace(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple()).first;
+
+		Entry& entry = found->second;
+
+		switch (shapeInfo.type) {
+		case Collider::Sphere:
+			entry.shape.emplace<btSphereShape>(shapeInfo.a * .5f);
+			break;
+		case Collider::Box:
+			entry.shape.emplace<btBoxShape>(btVector3(shapeInfo.a * .5f, shapeInfo.b * .5f, shapeInfo.c * .5f));
+			break;
+		case Collider::Plane:
+			entry.shape.emplace<btStaticPlaneShape>(btVector3(0, 0, 1), 1);
+			break;
+		case Collider::Capsule:
+			entry.shape.emplace<btCapsuleShapeZ>(shapeInfo.a * .5f, shapeInfo.b);
+			break;
+		case Collider::Cylinder:
+			entry.shape.emplace<btCylinderShapeZ>(btVector3(shapeInfo.a * .5f, shapeInfo.a * .5f, shapeInfo.b * .5f));
+			break;
+		case Collider::Cone:
+			entry.shape.emplace<btConeShapeZ>(shapeInfo.a * .5f, shapeInfo.b);
+			break;
+		case Collider::Mesh: {
+			btBvhTriangleMeshShape* meshShape = _meshLoader.loadMesh(shapeInfo.meshFile, shapeInfo.meshIndex);
+
+			if (!meshShape) {
+				_entries.erase(found);
+				return nullptr;
+			}
+
+			entry.shape.emplace<btScaledBvhTriangleMeshShape>(meshShape, btVector3(1, 1, 1));
+			break;
+		}
+		case Collider::ConvexMesh: {
+			ConvexDecompositionInfo decompositionInfo;
+			decompositionInfo.maxHulls = shapeInfo.maxHulls;
+			decompositionInfo.maxHullVertices = shapeInfo.maxHullVertices;
+
+			const ConvexHulls* hulls = _meshLoader.loadConvexHulls(shapeInfo.meshFile, shapeInfo.meshIndex, decompositionInfo);
+
+			if (!hulls || hulls->empty()) {
+				_entries.erase(found);
+				return nullptr;
+			}
+
+			// children are owned per entry, compound scaling rescales them
+			btCompoundShape& compound = entry.shape.emplace<btCompoundShape>(true, (int)hulls->size());
+
+			for (const auto& hull : *hulls) {
+				entry.children.push_back(std::make_unique<btConvexHullShape>(&hull[0].x(), hull.size(), sizeof(btVector3)));
+				compound.addChildShape(btTransform::getIdentity(), entry.children.back().get());
+			}
+
+			break;
+		}
+		}
+
+		btCollisionShape* shape = std::visit([](btCollisionShape& visitShape) { return (btCollisionShape*)&visitShape; }, entry.shape);
+
+		if (shapeInfo.type != Collider::Plane)
+			shape->setLocalScaling(toBt(scale));
+
+		_lookup.emplace(shape, found);
+	}
+
+	found->second.references++;
+
+	return std::visit([](btCollisionShape& visitShape) { return (btCollisionShape*)&visitShape; }, found->second.shape);
+}
+
+void ShapeCache::release(const btCollisionShape* shape) {
+	auto found = _lookup.find(shape);
+
+	if (found == _lookup.end())
+		return;
+
+	if (--found->second->second.references == 0) {
+		_entries.erase(found->second);
+		_lookup.erase(found);
+	}
+}
+
+uint32_t ShapeCache::shapeCount() const {
+	return (uint32_t)_entries.size();
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <btBulletDynamicsCommon.h>
+
+#include <glm\vec3.hpp>
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <variant>
+
+#include "component\Collider.hpp"
+
+#include "other\TriangleMeshLoader.hpp"
+
+// Reference counted collision shapes shared by every collider with the same shape info and global scale
+class ShapeCache {
+	using ShapeVariant = std::variant<
+		btSphereShape,
+		btBoxShape,
+		btCylinderShapeZ,
+		btCapsuleShapeZ,
+		btConeShapeZ,
+		btStaticPlaneShape,
+		btScaledBvhTriangleMeshShape, // scales a mesh shared by every scale
+		btCompoundShape
+	>;
+
+	struct Key {
+		Collider::ShapeType type;
+		float a, b, c, d;
+		std::string meshFile;
+		uint32_t meshIndex;
+		uint32_t maxHulls;
+		uint32_t maxHullVertices;
+		glm::vec3 scale;
+
+		bool operator<(const Key& other) const;
+	};
+
+	struct Entry {
+		ShapeVariant shape;
+		std::vector<std::unique_ptr<btCollisionShape>> children; // parts of compound shapes
+		uint32_t references = 0;
+
+		Entry();
+	};
+
+	// map nodes never move, so shapes handed out stay valid until released
+	std::map<Key, Entry> _entries;
+	std::unordered_map<const btCollisionShape*, std::map<Key, Entry>::iterator> _lookup;
+
+	TriangleMeshLoader _meshLoader;
+
+public:
+	// meshes are loaded relative to path
+	ShapeCache(const std::string& path);
+
+	// returns a shared shape with scale applied, create one if none matches, null if a mesh fails to load
+	btCollisionShape* acquire(const Collider::ShapeInfo& shapeInfo, const glm::vec3& scale);
+	// drops a reference taken by acquire, destroying the shape once unused
+	void release(const btCollisionShape* shape);
+
+	uint32_t shapeCount() const;
+};
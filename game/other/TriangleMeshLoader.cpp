@@ -0,0 +1,293 @@
+#include "other\TriangleMeshLoader.hpp"
+
+#include "other\Path.hpp"
+
+#include <assimp\Importer.hpp>
+#include <assimp\scene.h>
+#include <assimp\postprocess.h>
+
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <algorithm>
+#include <experimental\filesystem>
+
+struct BvhFileHeader {
+	char magic[4] = { 'B', 'V', 'H', '1' };
+	uint64_t sourceTime = 0; // asset write time the bvh was built from
+	uint32_t vertexCount = 0;
+	uint32_t indexCount = 0;
+	uint32_t bvhSize = 0;
+	uint32_t padding = 0;
+};
+
+// then hullCount hulls, each a vertex count and that many float xyz points
+struct HullsFileHeader {
+	char magic[4] = { 'H', 'U', 'L', '1' };
+	uint32_t hullCount = 0;
+};
+
+inline uint64_t writeTime(const std::string& file) {
+	std::error_code error;
+	auto time = std::experimental::filesystem::last_write_time(file, error);
+
+	return error ? 0 : (uint64_t)time.time_since_epoch().count();
+}
+
+TriangleMeshLoader::TriangleMeshLoader(const std::string& path) : _path(path) {
+}
+
+bool TriangleMeshLoader::_readBvh(const std::string& bvhFile, uint64_t sourceTime, LoadedMesh* loadedMesh) {
+	std::ifstream stream(bvhFile, std::ifstream::binary);
+
+	if (!stream.is_open())
+		return false;
+
+	BvhFileHeader header;
+	BvhFileHeader expected;
+
+	stream.read((char*)&header, sizeof(header));
+
+	if (!stream ||
+		std::memcmp(header.magic, expected.magic, sizeof(header.magic)) ||
+		header.sourceTime != sourceTime ||
+		header.vertexCount != loadedMesh->vertices.size() / 3 ||
+		header.indexCount != loadedMesh->indices.size())
+		return false;
+
+	loadedMesh->bvhBuffer.reset(new btVector3[(header.bvhSize + sizeof(btVector3) - 1) / sizeof(btVector3)]);
+	stream.read((char*)loadedMesh->bvhBuffer.get(), header.bvhSize);
+
+	if (!stream)
+		return false;
+
+	// pointers inside the buffer are patched in place, no tree is rebuilt
+	btOptimizedBvh* bvh = (btOptimizedBvh*)btOptimizedBvh::deSerializeInPlace(loadedMesh->bvhBuffer.get(), header.bvhSize, false);
+
+	if (!bvh)
+		return false;
+
+	loadedMesh->shape->setOptimizedBvh(bvh);
+
+	return true;
+}
+
+void TriangleMeshLoader::_writeBvh(const std::string& bvhFile, uint64_t sourceTime, const LoadedMesh& loadedMesh) {
+	btOptimizedBvh* bvh = loadedMesh.shape->getOptimizedBvh();
+
+	BvhFileHeader header;
+	header.sourceTime = sourceTime;
+	header.vertexCount = (uint32_t)loadedMesh.vertices.size() / 3;
+	header.indexCount = (uint32_t)loadedMesh.indices.size();
+	header.bvhSize = bvh->calculateSerializeBufferSize();
+
+	std::unique_ptr<btVector3[]> buffer(new btVector3[(header.bvhSize + sizeof(btVector3) - 1) / sizeof(btVector3)]);
+
+	if (!bvh->serializeInPlace(buffer.get(), header.bvhSize, false)) {
+		std::cerr << "TriangleMeshLoader writeBvh: couldn't serialize bvh for " << bvhFile << std::endl;
+		return;
+	}
+
+	std::ofstream stream(bvhFile, std::ofstream::binary | std::ofstream::trunc);
+
+	if (!stream.is_open()) {
+		std::cerr << "TriangleMeshLoader writeBvh: couldn't write " << bvhFile << std::endl;
+		return;
+	}
+
+	stream.write((const char*)&header, sizeof(header));
+	stream.write((const char*)buffer.get(), header.bvhSize);
+}
+
+bool TriangleMeshLoader::_importMesh(const std::string& meshFile, uint32_t meshIndex, std::vector<btScalar>* vertices, std::vector<int>* indices) {
+	const std::string meshPath = formatPath(_path, meshFile);
+
+	// same import as GlLoader::loadMesh, so collision matches what is drawn
+	Assimp::Importer importer;
+
+	const aiScene* scene = importer.ReadFile(meshPath, aiProcessPreset_TargetRealtime_MaxQuality);
+
+	if (!scene) {
+		std::cerr << "TriangleMeshLoader importMesh: couldn't load " << meshPath << std::endl;
+		return false;
+	}
+
+	if (meshIndex >= scene->mNumMeshes || !scene->mMeshes[meshIndex]->mNumFaces) {
+		std::cerr << "TriangleMeshLoader importMesh: no mesh " << meshIndex << " in " << meshPath << std::endl;
+		return false;
+	}
+
+	const aiMesh& mesh = *scene->mMeshes[meshIndex];
+
+	vertices->resize(mesh.mNumVertices * 3);
+
+	for (uint32_t i = 0; i < mesh.mNumVertices; i++) {
+		(*vertices)[i * 3] = mesh.mVertices[i].x;
+		(*vertices)[i * 3 + 1] = mesh.mVertices[i].y;
+		(*vertices)[i * 3 + 2] = mesh.mVertices[i].z;
+	}
+
+	// triangulated by the preset
+	indices->resize(mesh.mNumFaces * 3);
+
+	for (uint32_t i = 0; i < mesh.mNumFaces; i++)
+		for (uint32_t j = 0; j < 3; j++)
+			(*indices)[i * 3 + j] = mesh.mFaces[i].mIndices[j];
+
+	return true;
+}
+
+bool TriangleMeshLoader::_readHulls(const std::string& hullsFile, const ConvexDecompositionInfo& info, ConvexHulls* hulls) {
+	std::ifstream stream(hullsFile, std::ifstream::binary);
+
+	if (!stream.is_open())
+		return false;
+
+	HullsFileHeader header;
+	HullsFileHeader expected;
+	stream.read((char*)&header, sizeof(header));
+
+	// counts are checked against what decomposeConvex can produce, a corrupt file is rebuilt instead of sized from
+	if (!stream || std::memcmp(header.magic, expected.magic, sizeof(header.magic)) || header.hullCount > std::max(info.maxHulls, 1u))
+		return false;
+
+	hulls->resize(header.hullCount);
+
+	for (auto& hull : *hulls) {
+		uint32_t vertexCount = 0;
+		stream.read((char*)&vertexCount, sizeof(vertexCount));
+
+		if (!stream || vertexCount > std::max(info.maxHullVertices, 4u)) {
+			stream.setstate(std::ifstream::failbit);
+			break;
+		}
+
+		hull.resize(vertexCount);
+
+		for (uint32_t i = 0; i < vertexCount; i++) {
+			float point[3];
+			stream.read((char*)point, sizeof(point));
+
+			hull[i] = btVector3(point[0], point[1], point[2]);
+		}
+	}
+
+	if (!stream) {
+		hulls->clear();
+		return false;
+	}
+
+	return true;
+}
+
+void TriangleMeshLoader::_writeHulls(const std::string& hullsFile, const ConvexHulls& hulls) {
+	std::error_code error;
+	std::experimental::filesystem::create_directories(std::experimental::filesystem::path(hullsFile).parent_path(), error);
+
+	std::ofstream stream(hullsFile, std::ofstream::binary | std::ofstream::trunc);
+
+	if (!stream.is_open()) {
+		std::cerr << "TriangleMeshLoader writeHulls: couldn't write " << hullsFile << std::endl;
+		return;
+	}
+
+	HullsFileHeader header;
+	header.hullCount = (uint32_t)hulls.size();
+	stream.write((const char*)&header, sizeof(header));
+
+	for (const auto& hull : hulls) {
+		const uint32_t vertexCount = (uint32_t)hull.size();
+		stream.write((const char*)&vertexCount, sizeof(vertexCount));
+
+		for (int i = 0; i < hull.size(); i++) {
+			const float point[3] = { (float)hull[i].x(), (float)hull[i].y(), (float)hull[i].z() };
+			stream.write((const char*)point, sizeof(point));
+		}
+	}
+}
+
+btBvhTriangleMeshShape* TriangleMeshLoader::loadMesh(const std::string& meshFile, uint32_t meshIndex) {
+	auto meshIter = _loadedMeshes.find({ meshFile, meshIndex });
+
+	if (meshIter != _loadedMeshes.end())
+		return meshIter->second.shape.get();
+
+	LoadedMesh loadedMesh;
+
+	if (!_importMesh(meshFile, meshIndex, &loadedMesh.vertices, &loadedMesh.indices))
+		return nullptr;
+
+	const std::string meshPath = formatPath(_path, meshFile);
+	const uint32_t triangleCount = (uint32_t)loadedMesh.indices.size() / 3;
+	const uint32_t vertexCount = (uint32_t)loadedMesh.vertices.size() / 3;
+
+	loadedMesh.meshInterface = std::make_unique<btTriangleIndexVertexArray>(
+		triangleCount, loadedMesh.indices.data(), 3 * sizeof(int),
+		vertexCount, loadedMesh.vertices.data(), 3 * sizeof(btScalar));
+
+	const std::string bvhFile = meshPath + "." + std::to_string(meshIndex) + ".bvh";
+	const uint64_t sourceTime = writeTime(meshPath);
+
+	loadedMesh.shape = std::make_unique<btBvhTriangleMeshShape>(loadedMesh.meshInterface.get(), true, false);
+
+	if (!_readBvh(bvhFile, sourceTime, &loadedMesh)) {
+		loadedMesh.bvhBuffer.reset();
+		loadedMesh.shape->buildOptimizedBvh();
+
+		_writeBvh(bvhFile, sourceTime, loadedMesh);
+	}
+
+	// vectors keep their buffers when moved, so the mesh interface stays valid
+	return _loadedMeshes.emplace(std::make_pair(meshFile, meshIndex), std::move(loadedMesh)).first->second.shape.get();
+}
+
+const ConvexHulls* TriangleMeshLoader::loadConvexHulls(const std::string& meshFile, uint32_t meshIndex, const ConvexDecompositionInfo& info) {
+	const auto meshKey = std::make_tuple(meshFile, meshIndex, info.maxHulls, info.maxHullVertices, info.concavity);
+	auto meshIter = _hullsByMesh.find(meshKey);
+
+	if (meshIter != _hullsByMesh.end())
+		return meshIter->second;
+
+	std::vector<btScalar> vertices;
+	std::vector<int> indices;
+
+	if (!_importMesh(meshFile, meshIndex, &vertices, &indices))
+		return nullptr;
+
+	// fnv-1a over the geometry and settings, edited meshes and settings get new entries
+	uint64_t hash = 14695981039346656037ull;
+
+	auto hashBytes = [&](const void* data, size_t size) {
+		for (size_t i = 0; i < size; i++) {
+			hash ^= ((const uint8_t*)data)[i];
+			hash *= 1099511628211ull;
+		}
+	};
+
+	hashBytes(vertices.data(), vertices.size() * sizeof(btScalar));
+	hashBytes(indices.data(), indices.size() * sizeof(int));
+	hashBytes(&info.maxHulls, sizeof(info.maxHulls));
+	hashBytes(&info.maxHullVertices, sizeof(info.maxHullVertices));
+	hashBytes(&info.concavity, sizeof(info.concavity));
+
+	auto hullsIter = _loadedHulls.find(hash);
+
+	if (hullsIter != _loadedHulls.end())
+		return _hullsByMesh[meshKey] = &hullsIter->second;
+
+	char hashName[17];
+	snprintf(hashName, sizeof(hashName), "%016llx", (unsigned long long)hash);
+
+	const std::string hullsFile = formatPath(_path, std::string("cache/") + hashName + ".hulls");
+
+	ConvexHulls& hulls = _loadedHulls[hash];
+
+	if (!_readHulls(hullsFile, info, &hulls)) {
+		decomposeConvex(vertices.data(), (uint32_t)vertices.size() / 3, indices.data(), (uint32_t)indices.size(), info, &hulls);
+
+		_writeHulls(hullsFile, hulls);
+	}
+
+	return _hullsByMesh[meshKey] = &hulls;
+}
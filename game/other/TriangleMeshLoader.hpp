@@ -0,0 +1,48 @@
+#pragma once
+
+#include <btBulletCollisionCommon.h>
+
+#include "other\ConvexDecomposition.hpp"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <tuple>
+
+// Collision geometry imported like GlLoader::loadMesh. Static meshes cache their optimized bvh next to the asset,
+// convex decompositions are cached by mesh content hash
+class TriangleMeshLoader {
+	struct LoadedMesh {
+		std::vector<btScalar> vertices;
+		std::vector<int> indices;
+
+		std::unique_ptr<btTriangleIndexVertexArray> meshInterface;
+		std::unique_ptr<btBvhTriangleMeshShape> shape;
+
+		// deserialized bvh lives inside this buffer, 16 byte aligned
+		std::unique_ptr<btVector3[]> bvhBuffer;
+	};
+
+	const std::string _path;
+
+	std::map<std::pair<std::string, uint32_t>, LoadedMesh> _loadedMeshes;
+	std::map<uint64_t, ConvexHulls> _loadedHulls; // by content hash
+	std::map<std::tuple<std::string, uint32_t, uint32_t, uint32_t, float>, const ConvexHulls*> _hullsByMesh; // skips reimporting
+
+	bool _importMesh(const std::string& meshFile, uint32_t meshIndex, std::vector<btScalar>* vertices, std::vector<int>* indices);
+
+	bool _readHulls(const std::string& hullsFile, const ConvexDecompositionInfo& info, ConvexHulls* hulls);
+	void _writeHulls(const std::string& hullsFile, const ConvexHulls& hulls);
+
+	bool _readBvh(const std::string& bvhFile, uint64_t sourceTime, LoadedMesh* loadedMesh);
+	void _writeBvh(const std::string& bvhFile, uint64_t sourceTime, const LoadedMesh& loadedMesh);
+
+public:
+	TriangleMeshLoader(const std::string& path);
+
+	// unscaled shape for a mesh of the file, loaded shapes stay until the loader is destroyed
+	btBvhTriangleMeshShape* loadMesh(const std::string& meshFile, uint32_t meshIndex = 0);
+	// convex parts of a mesh for dynamic bodies, decomposed on first use
+	const ConvexHulls* loadConvexHulls(const std::string& meshFile, uint32_t meshIndex, const ConvexDecompositionInfo& info);
+};
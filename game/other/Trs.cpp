@@ -0,0 +1,138 @@
+#include "other\Trs.hpp"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define TRS_SSE 1
+#include <xmmintrin.h>
+#endif
+
+inline void composeSingle(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale, glm::mat4* matrix) {
+	const float x2 = rotation.x + rotation.x;
+	const float y2 = rotation.y + rotation.y;
+	const float z2 = rotation.z + rotation.z;
+
+	const float xx = rotation.x * x2;
+	const float yy = rotation.y * y2;
+	const float zz = rotation.z * z2;
+	const float xy = rotation.x * y2;
+	const float xz = rotation.x * z2;
+	const float yz = rotation.y * z2;
+	const float wx = rotation.w * x2;
+	const float wy = rotation.w * y2;
+	const float wz = rotation.w * z2;
+
+	glm::mat4& m = *matrix;
+
+	m[0][0] = (1.f - (yy + zz)) * scale.x;
+	m[0][1] = (xy + wz) * scale.x;
+	m[0][2] = (xz - wy) * scale.x;
+	m[0][3] = 0.f;
+
+	m[1][0] = (xy - wz) * scale.y;
+	m[1][1] = (1.f - (xx + zz)) * scale.y;
+	m[1][2] = (yz + wx) * scale.y;
+	m[1][3] = 0.f;
+
+	m[2][0] = (xz + wy) * scale.z;
+	m[2][1] = (yz - wx) * scale.z;
+	m[2][2] = (1.f - (xx + yy)) * scale.z;
+	m[2][3] = 0.f;
+
+	m[3][0] = position.x;
+	m[3][1] = position.y;
+	m[3][2] = position.z;
+	m[3][3] = 1.f;
+}
+
+#ifdef TRS_SSE
+// four packed vec3s (xyz xyz xyz xyz) to xxxx, yyyy, zzzz
+inline void loadVec3x4(const glm::vec3* from, __m128* x, __m128* y, __m128* z) {
+	const float* floats = &from->x;
+
+	const __m128 a = _mm_loadu_ps(floats); // x0 y0 z0 x1
+	const __m128 b = _mm_loadu_ps(floats + 4); // y1 z1 x2 y2
+	const __m128 c = _mm_loadu_ps(floats + 8); // z2 x3 y3 z3
+
+	*x = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+	*y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+	*z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+// transposes one column for each of the four matrices and stores it
+inline void storeColumnx4(glm::mat4* matrices, int column, __m128 a, __m128 b, __m128 c, __m128 d) {
+	_MM_TRANSPOSE4_PS(a, b, c, d);
+
+	_mm_storeu_ps(&matrices[0][column][0], a);
+	_mm_storeu_ps(&matrices[1][column][0], b);
+	_mm_storeu_ps(&matrices[2][column][0], c);
+	_mm_storeu_ps(&matrices[3][column][0], d);
+}
+
+inline void composeSse(const glm::vec3* positions, const glm::quat* rotations, const glm::vec3* scales, glm::mat4* matrices) {
+	// quats are stored x, y, z, w so a transpose gives xxxx, yyyy, zzzz, wwww
+	__m128 qx = _mm_loadu_ps(&rotations[0].x);
+	__m128 qy = _mm_loadu_ps(&rotations[1].x);
+	__m128 qz = _mm_loadu_ps(&rotations[2].x);
+	__m128 qw = _mm_loadu_ps(&rotations[3].x);
+
+	_MM_TRANSPOSE4_PS(qx, qy, qz, qw);
+
+	__m128 px, py, pz;
+	__m128 sx, sy, sz;
+
+	loadVec3x4(positions, &px, &py, &pz);
+	loadVec3x4(scales, &sx, &sy, &sz);
+
+	const __m128 x2 = _mm_add_ps(qx, qx);
+	const __m128 y2 = _mm_add_ps(qy, qy);
+	const __m128 z2 = _mm_add_ps(qz, qz);
+
+	const __m128 xx = _mm_mul_ps(qx, x2);
+	const __m128 yy = _mm_mul_ps(qy, y2);
+	const __m128 zz = _mm_mul_ps(qz, z2);
+	const __m128 xy = _mm_mul_ps(qx, y2);
+	const __m128 xz = _mm_mul_ps(qx, z2);
+	const __m128 yz = _mm_mul_ps(qy, z2);
+	const __m128 wx = _mm_mul_ps(qw, x2);
+	const __m128 wy = _mm_mul_ps(qw, y2);
+	const __m128 wz = _mm_mul_ps(qw, z2);
+
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 zero = _mm_setzero_ps();
+
+	storeColumnx4(matrices, 0,
+		_mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx),
+		_mm_mul_ps(_mm_add_ps(xy, wz), sx),
+		_mm_mul_ps(_mm_sub_ps(xz, wy), sx),
+		zero);
+
+	storeColumnx4(matrices, 1,
+		_mm_mul_ps(_mm_sub_ps(xy, wz), sy),
+		_mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy),
+		_mm_mul_ps(_mm_add_ps(yz, wx), sy),
+		zero);
+
+	storeColumnx4(matrices, 2,
+		_mm_mul_ps(_mm_add_ps(xz, wy), sz),
+		_mm_mul_ps(_mm_sub_ps(yz, wx), sz),
+		_mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz),
+		zero);
+
+	storeColumnx4(matrices, 3, px, py, pz, one);
+}
+#endif
+
+void composeTrs(const glm::vec3* positions, const glm::quat* rotations, const glm::vec3* scales, glm::mat4* matrices, size_t count) {
+	size_t i = 0;
+
+#ifdef TRS_SSE
+	for (; i + 4 <= count; i += 4)
+		composeSse(positions + i, rotations + i, scales + i, matrices + i);
+#endif
+
+	composeTrsScalar(positions + i, rotations + i, scales + i, matrices + i, count - i);
+}
+
+void composeTrsScalar(const glm::vec3* positions, const glm::quat* rotations, const glm::vec3* scales, glm::mat4* matrices, size_t count) {
+	for (size_t i = 0; i < count; i++)
+		composeSingle(positions[i], rotations[i], scales[i], &matrices[i]);
+}
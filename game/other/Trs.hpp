@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glm\vec3.hpp>
+#include <glm\gtc\quaternion.hpp>
+#include <glm\mat4x4.hpp>
+#include <glm\common.hpp>
+
+#include <cstddef>
+
+// Builds column-major matrices equivalent to translate(position) * mat4_cast(rotation) * scale(scale).
+// Batches of 4 go through SSE when available, the remainder (and non-SSE builds) use the scalar path.
+void composeTrs(const glm::vec3* positions, const glm::quat* rotations, const glm::vec3* scales, glm::mat4* matrices, size_t count);
+
+void composeTrsScalar(const glm::vec3* positions, const glm::quat* rotations, const glm::vec3* scales, glm::mat4* matrices, size_t count);
+
+// Composes a child's local TRS under its parent's global TRS. Returns false when the result is sheared (non-uniform
+// parent scale with a rotated child) and can't be represented as TRS, callers then need to fall back to matrices.
+inline bool composeTrsChild(
+		const glm::vec3& parentPosition, const glm::quat& parentRotation, const glm::vec3& parentScale,
+		const glm::vec3& localPosition, const glm::quat& localRotation, const glm::vec3& localScale,
+		glm::vec3* position, glm::quat* rotation, glm::vec3* scale) {
+
+	*position = parentPosition + parentRotation * (parentScale * localPosition);
+	*rotation = parentRotation * localRotation;
+	*scale = parentScale * localScale;
+
+	const float epsilon = 1e-5f;
+
+	const bool uniformScale =
+		glm::abs(parentScale.x - parentScale.y) <= epsilon * glm::abs(parentScale.x) &&
+		glm::abs(parentScale.x - parentScale.z) <= epsilon * glm::abs(parentScale.x);
+
+	// w barely leaves 1 for small rotations, so the vector part is checked, any real rotation shears under a stretched parent
+	const float rotationEpsilon = 1e-7f;
+
+	const bool unrotated =
+		glm::abs(localRotation.x) <= rotationEpsilon &&
+		glm::abs(localRotation.y) <= rotationEpsilon &&
+		glm::abs(localRotation.z) <= rotationEpsilon;
+
+	return uniformScale || unrotated;
+}
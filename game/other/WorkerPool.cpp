@@ -0,0 +1,98 @@
+#include "other\WorkerPool.hpp"
+
+void WorkerPool::_work() {
+	while (true) {
+		const uint32_t i = _nextTask++;
+
+		if (i >= _taskCount)
+			return;
+
+		(*_task)(i);
+
+		_completedTasks++;
+	}
+}
+
+void WorkerPool::_workerLoop() {
+	uint64_t generation = 0;
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(_lock);
+			_wake.wait(lock, [&] { return _stopping || _generation != generation; });
+
+			if (_stopping)
+				return;
+
+			generation = _generation;
+			_activeWorkers++;
+		}
+
+		_work();
+
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			_activeWorkers--;
+		}
+
+		_done.notify_all();
+	}
+}
+
+WorkerPool::WorkerPool(uint32_t threadCount) {
+	for (uint32_t i = 0; i < threadCount; i++)
+		_threads.emplace_back(&WorkerPool::_workerLoop, this);
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		_stopping = true;
+	}
+
+	_wake.notify_all();
+
+	for (std::thread& thread : _threads)
+		thread.join();
+}
+
+uint32_t WorkerPool::threadCount() const {
+	return (uint32_t)_threads.size();
+}
+
+void WorkerPool::run(uint32_t count, const std::function<void(uint32_t)>& task) {
+	if (!count)
+		return;
+
+	// nothing to gain from waking workers for one task
+	if (_threads.empty() || count == 1) {
+		for (uint32_t i = 0; i < count; i++)
+			task(i);
+
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(_lock);
+
+		// a late worker may still be leaving the last batch
+		_done.wait(lock, [&] { return _activeWorkers == 0; });
+
+		_task = &task;
+		_taskCount = count;
+		_nextTask = 0;
+		_completedTasks = 0;
+		_generation++;
+	}
+
+	_wake.notify_all();
+
+	_work();
+
+	// workers still inside _work may be reading _task, wait for them to leave before returning
+	std::unique_lock<std::mutex> lock(_lock);
+	_done.wait(lock, [&] { return _completedTasks == _taskCount && _activeWorkers == 0; });
+
+	_task = nullptr;
+	_taskCount = 0;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <vector>
+#include <algorithm>
+
+// Persistent worker threads for splitting a frame's work into independent tasks
+class WorkerPool {
+	std::vector<std::thread> _threads;
+
+	std::mutex _lock;
+	std::condition_variable _wake;
+	std::condition_variable _done;
+
+	// current batch, only replaced once every worker has left it
+	const std::function<void(uint32_t)>* _task = nullptr;
+	uint32_t _taskCount = 0;
+	std::atomic<uint32_t> _nextTask{ 0 };
+	std::atomic<uint32_t> _completedTasks{ 0 };
+
+	uint64_t _generation = 0;
+	uint32_t _activeWorkers = 0;
+	bool _stopping = false;
+
+	void _work();
+	void _workerLoop();
+
+public:
+	// defaults to one thread less than the hardware has, as the calling thread works too
+	WorkerPool(uint32_t threadCount = std::max(std::thread::hardware_concurrency(), 1u) - 1);
+	~WorkerPool();
+
+	uint32_t threadCount() const;
+
+	// calls task(i) for every i in [0, count) across the workers and calling thread, returns when all are done
+	void run(uint32_t count, const std::function<void(uint32_t)>& task);
+};
@@ -1,9 +1,11 @@
 #include "system\Audio.hpp"
+#include "system\Hierarchy.hpp"
 
 #include "component\Name.hpp"
 #include "component\Collider.hpp"
 
 #include "other\Path.hpp"
+#include "other\ContactStream.hpp"
 
 #include <libnyquist\Decoders.h>
 
@@ -36,13 +38,12 @@ nqr::AudioData * Audio::_loadAudio(const std::string & file){
 
 void Audio::_updateListener(){
 	AudioListener listener;
-	_listenerEntity.component<const Transform>()->globalDecomposed(&listener.globalPosition, &listener.globalRotation);
+	_hierarchy->globalDecomposed(_listenerEntity, &listener.globalPosition, &listener.globalRotation);
 
 	setAudioListener(&_audioThread, listener);
 }
 
 void Audio::_updateSource(entityx::Entity sourceEntity){
-	auto transform = sourceEntity.component<Transform>();
 	auto sound = sourceEntity.component<Sound>();
 
 	// Skip if sound has no source context
@@ -53,7 +54,7 @@ void Audio::_updateSource(entityx::Entity sourceEntity){
 	AudioSource audioSource;
 	audioSource.soundSettings = sound->settings;
 
-	transform->globalDecomposed(&audioSource.globalPosition, &audioSource.globalRotation);
+	_hierarchy->globalDecomposed(sourceEntity, &audioSource.globalPosition, &audioSource.globalRotation);
 
 	setAudioSource(&_audioThread, sound->sourceContextIndex, audioSource);
 }
@@ -61,7 +62,10 @@ void Audio::_updateSource(entityx::Entity sourceEntity){
 Audio::Audio(const ConstructorInfo& constructorInfo) :
 		_sampleRate(constructorInfo.sampleRate), 
 		_frameSize(constructorInfo.frameSize),
-		_path(constructorInfo.path) {
+		_path(constructorInfo.path),
+		_hierarchy(constructorInfo.hierarchy) {
+
+	assert(constructorInfo.hierarchy);
 
 	createAudioThread(&_audioThread, 48000, 512);
 }
@@ -71,8 +75,7 @@ Audio::~Audio(){
 }
 
 void Audio::configure(entityx::EventManager & events){
-	events.subscribe<ContactEvent>(*this);
-	events.subscribe<CollidingEvent>(*this);
+	events.subscribe<ContactStreamEvent>(*this);
 	events.subscribe<entityx::ComponentAddedEvent<Listener>>(*this);
 	events.subscribe<entityx::ComponentAddedEvent<Sound>>(*this);
 	events.subscribe<entityx::ComponentRemovedEvent<Sound>>(*this);
@@ -125,8 +128,7 @@ void Audio::receive(const entityx::ComponentAddedEvent<Sound>& soundAddedEvent)
 
 	// If transform, set position, else not playing
 	if (soundAddedEvent.entity.has_component<Transform>()) {
-		auto transform = soundAddedEvent.entity.component<const Transform>();
-		transform->globalDecomposed(&audioSource.globalPosition, &audioSource.globalRotation);
+		_hierarchy->globalDecomposed(soundAddedEvent.entity, &audioSource.globalPosition, &audioSource.globalRotation);
 	}
 	else {
 		sound->settings.playing = false; // don't play for now
@@ -183,11 +185,6 @@ void Audio::receive(const entityx::ComponentRemovedEvent<Transform>& transformAd
 //	sound->settings.seek = 0;
 //}
 
-void Audio::receive(const CollidingEvent & collidingEvent){
-	//entityCollidingEvent(collidingEvent.firstEntity);
-	//entityCollidingEvent(collidingEvent.secondEntity);
-}
-
 //void entityContactEvent(entityx::Entity entity, const ContactEvent & contactEvent) {
 //	if (!entity.has_component<Sound>())
 //		return;
@@ -210,7 +207,14 @@ void Audio::receive(const CollidingEvent & collidingEvent){
 //	sound->settings.falloffPower = glm::clamp(relativeImpulse, 0.f, 1000.f) / 1000.f;
 //}
 
-void Audio::receive(const ContactEvent & contactEvent){
-	//entityContactEvent(contactEvent.firstEntity, contactEvent);
-	//entityContactEvent(contactEvent.secondEntity, contactEvent);
+void Audio::receive(const ContactStreamEvent& contactStreamEvent){
+	//for (const CollidingEvent& collidingEvent : contactStreamEvent.stream->colliding()) {
+	//	entityCollidingEvent(collidingEvent.firstEntity);
+	//	entityCollidingEvent(collidingEvent.secondEntity);
+	//}
+
+	//for (const ContactEvent& contactEvent : contactStreamEvent.stream->contacts()) {
+	//	entityContactEvent(contactEvent.firstEntity, contactEvent);
+	//	entityContactEvent(contactEvent.secondEntity, contactEvent);
+	//}
 }
\ No newline at end of file
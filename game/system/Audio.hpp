@@ -14,10 +14,13 @@
 
 #include <libnyquist\Decoders.h>
 
+class Hierarchy;
+
 class Audio : public entityx::System<Audio>, public entityx::Receiver<Audio> {
 	const std::string _path;
 	const uint32_t _sampleRate;
 	const uint32_t _frameSize;
+	const Hierarchy* _hierarchy;
 
 	AudioThreadContext _audioThread;
 
@@ -36,6 +39,7 @@ public:
 		std::string path = "";
 		uint32_t sampleRate = 48000;
 		uint32_t frameSize = 512; // 512 min
+		const Hierarchy* hierarchy = nullptr;
 	};
 
 	Audio(const ConstructorInfo& constructorInfo);
@@ -49,6 +53,5 @@ public:
 	void receive(const entityx::ComponentRemovedEvent<Sound>& soundAddedEvent);
 	void receive(const entityx::ComponentAddedEvent<Transform>& transformAddedEvent);
 	void receive(const entityx::ComponentRemovedEvent<Transform>& transformAddedEvent);
-	void receive(const CollidingEvent& collidingEvent);
-	void receive(const ContactEvent& contactEvent);
+	void receive(const ContactStreamEvent& contactStreamEvent);
 };
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "component\Collider.hpp"
 
 #include "other\GlmPrint.hpp"
+#include "other\ContactStream.hpp"
 
 Controller::Controller(const ConstructorInfo & constructorInfo) :
 	_enabled(constructorInfo.defaultEnabled), 
@@ -19,7 +20,7 @@ void Controller::configure(entityx::EventManager &events){
 	events.subscribe<KeyInputEvent>(*this);
 	events.subscribe<MousePressEvent>(*this);
 	events.subscribe<ScrollWheelEvent>(*this);
-	events.subscribe<CollidingEvent>(*this);
+	events.subscribe<ContactStreamEvent>(*this);
 }
 
 void Controller::update(entityx::EntityManager &entities, entityx::EventManager &events, double dt){
@@ -54,7 +55,7 @@ void Controller::update(entityx::EntityManager &entities, entityx::EventManager
 	auto headTransform = _head.component<Transform>();
 	auto bodyTransform = _body.component<Transform>();
 
-	if (headTransform->parent != _body)
+	if (headTransform->parent() != _body)
 		return;
 		
 	_mousePos = glm::mix(_mousePos, _dMousePos, 50 * dt);
@@ -63,7 +64,7 @@ void Controller::update(entityx::EntityManager &entities, entityx::EventManager
 	_xAngle -= _mousePos.y * dt;
 	_xAngle = glm::clamp(_xAngle, -glm::half_pi<float>(), glm::half_pi<float>());
 	
-	headTransform->rotation = glm::quat(glm::vec3{ _xAngle, 0, 0 });
+	headTransform->setRotation(glm::quat(glm::vec3{ _xAngle, 0, 0 }));
 	
 	float moveSpeed = _walkSpeed;
 	
@@ -107,14 +108,14 @@ void Controller::update(entityx::EntityManager &entities, entityx::EventManager
 		return;
 
 	if (_down && !_crouched) {
-		bodyTransform->scale.z *= 0.5;
-		bodyTransform->position.z -= 35;
+		bodyTransform->localScale({ 1.f, 1.f, 0.5f });
+		bodyTransform->globalTranslate(Transform::down * 35.f);
 
 		_crouched = true;
 	}
 	else if (!_down && _crouched){
-		bodyTransform->scale.z *= 2;
-		bodyTransform->position.z += 35;
+		bodyTransform->localScale({ 1.f, 1.f, 2.f });
+		bodyTransform->globalTranslate(Transform::up * 35.f);
 
 		_crouched = false;
 	}
@@ -183,9 +184,12 @@ void Controller::receive(const ScrollWheelEvent& scrollWheelEvent){
 
 }
 
-void Controller::receive(const CollidingEvent& collidingEvent){
-	if (collidingEvent.firstEntity == _body || collidingEvent.secondEntity == _body) {
-		if (collidingEvent.colliding)
+void Controller::receive(const ContactStreamEvent& contactStreamEvent){
+	if (!_body.valid())
+		return;
+
+	for (const CollidingEvent* collidingEvent : contactStreamEvent.stream->colliding(_body)) {
+		if (collidingEvent->colliding)
 			_touchingCount++;
 		else
 			_touchingCount--;
@@ -62,7 +62,7 @@ public:
 	void receive(const KeyInputEvent& keyInputEvent);
 	void receive(const MousePressEvent& mousePressEvent);
 	void receive(const ScrollWheelEvent& scrollWheelEvent);
-	void receive(const CollidingEvent& collidingEvent);
+	void receive(const ContactStreamEvent& contactStreamEvent);
 
 	void setEnabled(bool enabled);
 	void setControlled(entityx::Entity head, entityx::Entity body);
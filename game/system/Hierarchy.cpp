@@ -0,0 +1,247 @@
+#include "system\Hierarchy.hpp"
+
+#include "other\Trs.hpp"
+
+#include <algorithm>
+
+Hierarchy::Hierarchy(const ConstructorInfo& constructorInfo) :
+	_workers(constructorInfo.workers),
+	_parallelThreshold(constructorInfo.parallelThreshold) {
+}
+
+void Hierarchy::_rebuildOrder(entityx::EntityManager& entities) {
+	_order.clear();
+
+	std::vector<entityx::Entity> roots;
+
+	uint32_t maxIndex = 0;
+
+	for (entityx::Entity entity : entities.entities_with_components<Transform>()) {
+		auto transform = entity.component<Transform>();
+
+		entityx::Entity parent = transform->_parent;
+
+		if (!parent.valid() || !parent.has_component<Transform>())
+			parent = entityx::Entity();
+
+		// relink children whose parent's Transform was removed and assigned again
+		if (transform->_linkedParent != parent)
+			transform->_link(entity, parent);
+
+		if (!parent.valid())
+			roots.push_back(entity);
+
+		maxIndex = std::max(maxIndex, entity.id().index());
+	}
+
+	_slots.resize(maxIndex + 1);
+	_slotIds.assign(maxIndex + 1, entityx::Entity::INVALID);
+
+	// depth first from each root, so each subtree is contiguous (setParent never lets a cycle form)
+	std::vector<Range> subtrees;
+
+	for (entityx::Entity root : roots) {
+		subtrees.push_back({ (uint32_t)_order.size(), 0 });
+
+		for (entityx::Entity entity : Transform::subtree(root)) {
+			Node node;
+			node.id = entity.id();
+			node.transform = entity.component<const Transform>().get();
+			node.parentId = node.transform->_parent.id();
+			node.root = entity == root;
+			node.parentSlot = node.root ? 0 : _slots[node.parentId.index()];
+
+			_slots[node.id.index()] = (uint32_t)_order.size();
+			_slotIds[node.id.index()] = node.id;
+
+			_order.push_back(node);
+		}
+
+		subtrees.back().end = (uint32_t)_order.size();
+	}
+
+	_rebuildChunks(subtrees);
+
+	const size_t count = _order.size();
+
+	_localPositions.resize(count);
+	_localRotations.resize(count);
+	_localScales.resize(count);
+
+	_globalPositions.resize(count);
+	_globalRotations.resize(count);
+	_globalScales.resize(count);
+	_sheared.resize(count);
+
+	_globalMatrices.resize(count);
+
+	_orderDirty = false;
+}
+
+void Hierarchy::_rebuildChunks(const std::vector<Range>& subtrees) {
+	_chunks.clear();
+
+	const uint32_t count = (uint32_t)_order.size();
+
+	if (!count)
+		return;
+
+	// too small to be worth waking workers, sweep as one chunk
+	if (!_workers || !_workers->threadCount() || count < _parallelThreshold) {
+		_chunks.push_back({ 0, count });
+		return;
+	}
+
+	// a few chunks per thread to balance uneven subtrees, never splitting a subtree
+	const uint32_t chunkTarget = std::max(count / ((_workers->threadCount() + 1) * 4), _parallelThreshold / 4);
+
+	Range chunk;
+
+	for (const Range& subtree : subtrees) {
+		chunk.end = subtree.end;
+
+		if (chunk.end - chunk.begin >= chunkTarget) {
+			_chunks.push_back(chunk);
+			chunk.begin = chunk.end;
+		}
+	}
+
+	if (chunk.end != chunk.begin)
+		_chunks.push_back(chunk);
+}
+
+bool Hierarchy::_parentsChanged() const {
+	for (const Node& node : _order) {
+		if (node.transform->_parent.id() != node.parentId)
+			return true;
+	}
+
+	return false;
+}
+
+const uint32_t* Hierarchy::_slot(entityx::Entity entity) const {
+	const uint32_t index = entity.id().index();
+
+	if (index < _slotIds.size() && _slotIds[index] == entity.id())
+		return &_slots[index];
+
+	return nullptr;
+}
+
+void Hierarchy::_sweep(const Range& range) {
+	for (uint32_t i = range.begin; i < range.end; i++) {
+		const Transform& transform = *_order[i].transform;
+
+		_localPositions[i] = transform._position;
+		_localRotations[i] = transform._rotation;
+		_localScales[i] = transform._scale;
+	}
+
+	// compose global TRS in one pass, parents are always written before their children read them
+	for (uint32_t i = range.begin; i < range.end; i++) {
+		const Node& node = _order[i];
+
+		if (node.root) {
+			_globalPositions[i] = _localPositions[i];
+			_globalRotations[i] = _localRotations[i];
+			_globalScales[i] = _localScales[i];
+			_sheared[i] = false;
+			continue;
+		}
+
+		const uint32_t parent = node.parentSlot;
+
+		const bool composed = composeTrsChild(
+			_globalPositions[parent], _globalRotations[parent], _globalScales[parent],
+			_localPositions[i], _localRotations[i], _localScales[i],
+			&_globalPositions[i], &_globalRotations[i], &_globalScales[i]);
+
+		_sheared[i] = _sheared[parent] || !composed;
+	}
+
+	// batch global matrices straight from global TRS
+	composeTrs(&_globalPositions[range.begin], &_globalRotations[range.begin], &_globalScales[range.begin], &_globalMatrices[range.begin], range.end - range.begin);
+
+	// sheared subtrees can't be expressed as TRS, rebuild those from the parent matrix
+	for (uint32_t i = range.begin; i < range.end; i++) {
+		if (!_sheared[i])
+			continue;
+
+		glm::mat4 localMatrix;
+		composeTrs(&_localPositions[i], &_localRotations[i], &_localScales[i], &localMatrix, 1);
+
+		_globalMatrices[i] = _globalMatrices[_order[i].parentSlot] * localMatrix;
+	}
+}
+
+void Hierarchy::configure(entityx::EventManager& events) {
+	events.subscribe<entityx::ComponentAddedEvent<Transform>>(*this);
+	events.subscribe<entityx::ComponentRemovedEvent<Transform>>(*this);
+}
+
+void Hierarchy::update(entityx::EntityManager& entities, entityx::EventManager& events, double dt) {
+	if (_orderDirty || _parentsChanged())
+		_rebuildOrder(entities);
+
+	if (_chunks.empty())
+		return;
+
+	if (_chunks.size() == 1) {
+		_sweep(_chunks[0]);
+		return;
+	}
+
+	// subtrees never reference each other, so chunks can be swept in any order
+	_workers->run((uint32_t)_chunks.size(), [&](uint32_t i) {
+		_sweep(_chunks[i]);
+	});
+}
+
+void Hierarchy::receive(const entityx::ComponentAddedEvent<Transform>& transformAddedEvent) {
+	_orderDirty = true;
+}
+
+void Hierarchy::receive(const entityx::ComponentRemovedEvent<Transform>& transformRemovedEvent) {
+	auto transform = transformRemovedEvent.component;
+
+	// leave the parent's child list, children become roots until re-parented
+	transform->_unlink();
+	transform->_unlinkChildren();
+
+	const uint32_t index = transformRemovedEvent.entity.id().index();
+
+	if (index < _slotIds.size())
+		_slotIds[index] = entityx::Entity::INVALID;
+
+	_orderDirty = true;
+}
+
+const glm::mat4& Hierarchy::globalMatrix(entityx::Entity entity) const {
+	const uint32_t* slot = _slot(entity);
+
+	if (slot)
+		return _globalMatrices[*slot];
+
+	return entity.component<const Transform>()->globalMatrix();
+}
+
+void Hierarchy::globalDecomposed(entityx::Entity entity, glm::vec3* position, glm::quat* rotation, glm::vec3* scale) const {
+	const uint32_t* slot = _slot(entity);
+
+	if (!slot) {
+		entity.component<const Transform>()->globalDecomposed(position, rotation, scale);
+		return;
+	}
+
+	if (_sheared[*slot]) {
+		Transform::decompose(_globalMatrices[*slot], position, rotation, scale);
+		return;
+	}
+
+	if (position)
+		*position = _globalPositions[*slot];
+	if (rotation)
+		*rotation = _globalRotations[*slot];
+	if (scale)
+		*scale = _globalScales[*slot];
+}
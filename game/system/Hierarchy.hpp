@@ -0,0 +1,78 @@
+#pragma once
+
+#include <entityx\System.h>
+
+#include "component\Transform.hpp"
+
+#include "other\WorkerPool.hpp"
+
+#include <vector>
+
+class Hierarchy : public entityx::System<Hierarchy>, public entityx::Receiver<Hierarchy> {
+public:
+	struct ConstructorInfo {
+		WorkerPool* workers = nullptr; // sweeps on the calling thread without
+		uint32_t parallelThreshold = 4096; // transforms needed before the sweep is split across workers
+	};
+
+private:
+	struct Node {
+		entityx::Entity::Id id;
+		entityx::Entity::Id parentId; // parent this node was sorted under, used to detect re-parenting
+		const Transform* transform = nullptr;
+		uint32_t parentSlot = 0; // position of parent in _order, ignored for roots
+		bool root = true;
+	};
+
+	struct Range {
+		uint32_t begin = 0;
+		uint32_t end = 0;
+	};
+
+	WorkerPool* const _workers;
+	const uint32_t _parallelThreshold;
+
+	// every Transform entity, parents always before their children
+	std::vector<Node> _order;
+	bool _orderDirty = true;
+
+	// runs of whole root subtrees, each can be swept independently
+	std::vector<Range> _chunks;
+
+	// position in _order, indexed by entity index
+	std::vector<uint32_t> _slots;
+	std::vector<entityx::Entity::Id> _slotIds;
+
+	// per slot results of the last sweep
+	std::vector<glm::vec3> _localPositions;
+	std::vector<glm::quat> _localRotations;
+	std::vector<glm::vec3> _localScales;
+
+	std::vector<glm::vec3> _globalPositions;
+	std::vector<glm::quat> _globalRotations;
+	std::vector<glm::vec3> _globalScales;
+	std::vector<uint8_t> _sheared; // global TRS is unusable, matrix was built from the parent matrix instead
+
+	std::vector<glm::mat4> _globalMatrices;
+
+	void _rebuildOrder(entityx::EntityManager& entities);
+	void _rebuildChunks(const std::vector<Range>& subtrees);
+	bool _parentsChanged() const;
+
+	void _sweep(const Range& range);
+
+	const uint32_t* _slot(entityx::Entity entity) const;
+
+public:
+	Hierarchy(const ConstructorInfo& constructorInfo = ConstructorInfo());
+
+	void configure(entityx::EventManager &events) final;
+	void update(entityx::EntityManager &entities, entityx::EventManager &events, double dt) final;
+
+	void receive(const entityx::ComponentAddedEvent<Transform>& transformAddedEvent);
+	void receive(const entityx::ComponentRemovedEvent<Transform>& transformRemovedEvent);
+
+	// both fall back to the Transform's own cache for entities not yet swept (i.e. created this frame)
+	const glm::mat4& globalMatrix(entityx::Entity entity) const;
+	void globalDecomposed(entityx::Entity entity, glm::vec3* position, glm::quat* rotation = nullptr, glm::vec3* scale = nullptr) const;
+};
@@ -69,13 +69,21 @@ void Interface::update(entityx::EntityManager & entities, entityx::EventManager
 			
 			ImGui::Text("Transform");
 	
-			ImGui::InputFloat3("Position", &transform->position[0]);
+			// written back only when edited, so the transform isn't dirtied every frame
+			glm::vec3 position = transform->position();
+
+			if (ImGui::InputFloat3("Position", &position[0]))
+				transform->setPosition(position);
 	
-			glm::vec3 eulerAngles = glm::degrees(glm::eulerAngles(transform->rotation));
-			ImGui::InputFloat3("Rotation", &eulerAngles[0]);
-			transform->rotation = glm::quat(glm::radians(eulerAngles));
+			glm::vec3 eulerAngles = glm::degrees(glm::eulerAngles(transform->rotation()));
+
+			if (ImGui::InputFloat3("Rotation", &eulerAngles[0]))
+				transform->setRotation(glm::quat(glm::radians(eulerAngles)));
 	
-			ImGui::InputFloat3("Scale", &transform->scale[0]);
+			glm::vec3 scale = transform->scale();
+
+			if (ImGui::InputFloat3("Scale", &scale[0]))
+				transform->setScale(scale);
 		}
 	
 		ImGui::End();
@@ -1,15 +1,27 @@
 #include <btBulletCollisionCommon.h>
 #include <BulletCollision\NarrowPhaseCollision\btRaycastCallback.h>
 #include <BulletDynamics\Dynamics\btRigidBody.h>
+#include <BulletDynamics\Dynamics\btDiscreteDynamicsWorldMt.h>
+#include <BulletCollision\CollisionDispatch\btCollisionDispatcherMt.h>
 
 #include "component\Transform.hpp"
 
 #include "system\Physics.hpp"
 #include "system\PhysicsEvents.hpp"
+#include "system\Hierarchy.hpp"
+
+#include "other\WorkerPool.hpp"
+
+#include <mutex>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
 
 entityx::EventManager* eventsPtr;
 
-std::vector<btPersistentManifold*> manifolds;
+// contact callbacks run on bullet's narrowphase threads, so events are queued and collected into the contact stream after stepping
+std::mutex pendingCollidingLock;
+std::vector<CollidingEvent> pendingColliding;
 
 inline void readConctactPoint(const btManifoldPoint& from, ContactEvent::Contact* to) {
 	to->contactImpulse = from.getAppliedImpulse();
@@ -45,201 +57,2154 @@ inline void contactCallback(btPersistentManifold* const& manifold) {
 
 	readManifold(manifold, &collidingEvent);
 	
-	eventsPtr->emit<CollidingEvent>(collidingEvent);
+	std::lock_guard<std::mutex> lock(pendingCollidingLock);
+	pendingColliding.push_back(collidingEvent);
 }
 
-inline void internalTickCallback(btDynamicsWorld* world, btScalar timeStep) {
-	// process manifolds
-	for (uint32_t i = 0; i < world->getDispatcher()->getNumManifolds(); i++) {
-		const auto manifold = world->getDispatcher()->getManifoldByIndexInternal(i);
+inline bool listsContacts(entityx::Entity entity) {
+	return entity.valid() && entity.has_component<Collider>() && entity.component<Collider>()->bodyInfo.callbacks;
+}
 
-		Collider* firstCollider = (Collider*)manifold->getBody0()->getUserPointer();
-		Collider* secondCollider = (Collider*)manifold->getBody1()->getUserPointer();
+// writes up to maxHits of the nearest hits to out, returns how many
+inline uint32_t nearestHits(std::vector<Physics::QueryHit>& found, uint32_t maxHits, Physics::QueryHit* out) {
+	const uint32_t count = std::min((uint32_t)found.size(), maxHits);
 
-		if ((!firstCollider->bodyInfo.callbacks && !secondCollider->bodyInfo.callbacks) ||
-			(!manifold->getBody0()->isActive() && !manifold->getBody1()->isActive()))
-			continue;
+	std::partial_sort(found.begin(), found.begin() + count, found.end(), [](const Physics::QueryHit& a, const Physics::QueryHit& b) {
+		return a.fraction < b.fraction;
+	});
 
-		ContactEvent contactEvent;
-		contactEvent.firstEntity = firstCollider->self;
-		contactEvent.secondEntity = secondCollider->self;
+	std::copy(found.begin(), found.begin() + count, out);
 
-		readManifold(manifold, &contactEvent);
+	return count;
+}
 
-		float impulse = readManifold(manifold, &contactEvent);
+// bullet only ships a closest hit sweep callback, this one keeps every hit
+struct AllConvexResultCallback : public btCollisionWorld::ConvexResultCallback {
+	std::vector<Physics::QueryHit> found;
 
-		if (impulse == 0)
-			continue;
+	btScalar addSingleResult(btCollisionWorld::LocalConvexResult& convexResult, bool normalInWorldSpace) final {
+		Physics::QueryHit hit;
+		hit.entity = ((Collider*)convexResult.m_hitCollisionObject->getUserPointer())->self;
+		hit.globalPosition = fromBt(convexResult.m_hitPointLocal); // already in world space
+		hit.globalNormal = fromBt(normalInWorldSpace ? convexResult.m_hitNormalLocal :
+			convexResult.m_hitCollisionObject->getWorldTransform().getBasis() * convexResult.m_hitNormalLocal);
+		hit.fraction = convexResult.m_hitFraction;
+
+		found.push_back(hit);
+
+		// not lowered, so the sweep keeps reporting hits further away
+		return m_closestHitFraction;
+	}
+};
+
+// leaves trigger ghosts out of ray and sweep results unless the query asks for them
+template <class Callback>
+struct QueryCallback : public Callback {
+	using Callback::Callback;
+
+	bool triggers = false;
+
+	bool needsCollision(btBroadphaseProxy* proxy) const final {
+		const btCollisionObject* object = (const btCollisionObject*)proxy->m_clientObject;
+
+		if (!triggers && (object->getCollisionFlags() & btCollisionObject::CF_NO_CONTACT_RESPONSE))
+			return false;
+
+		return Callback::needsCollision(proxy);
+	}
+};
+
+// Snapshot layout, a header then one BodyState per non static body then each manifold's header and points
+struct StateHeader {
+	char magic[4] = { 'P', 'H', 'S', '2' };
+	btScalar accumulator = 0;
+	uint32_t objectCount = 0;
+	uint32_t bodyCount = 0;
+	uint32_t manifoldCount = 0;
+};
+
+// raw bullet types, so a restore reproduces the saved state bit for bit
+struct BodyState {
+	uint64_t id; // entity id, checked against the current bodies before restoring
+	btTransform worldTransform;
+	btTransform interpolationWorldTransform;
+	btTransform previousTransform;
+	btTransform currentTransform;
+	btVector3 linearVelocity;
+	btVector3 angularVelocity;
+	btVector3 interpolationLinearVelocity;
+	btVector3 interpolationAngularVelocity;
+	btScalar deactivationTime;
+	int32_t activationState;
+	uint8_t settled;
+};
+
+struct ManifoldState {
+	uint32_t firstObject; // world array indices
+	uint32_t secondObject;
+	uint64_t firstId; // entity ids of the same objects, so a shuffled world array can't match the wrong pair
+	uint64_t secondId;
+	uint32_t pointCount;
+};
+
+// entity of the collider behind a collision object, 0 for bodies removed inside a batch
+inline uint64_t objectId(const btCollisionObject* object) {
+	const Collider* collider = (const Collider*)object->getUserPointer();
+	return collider ? collider->self.id().id() : 0;
+}
+
+// objects still owned by a collider, bodies removed inside a batch have none
+template <class T>
+inline uint32_t liveObjects(const btAlignedObjectArray<T*>& objects) {
+	uint32_t count = 0;
+
+	for (int i = 0; i < objects.size(); i++) {
+		if (objects[i]->getUserPointer())
+			count++;
+	}
+
+	return count;
+}
+
+template <class T>
+inline void writeState(std::vector<uint8_t>& buffer, const T& value) {
+	const size_t offset = buffer.size();
+	buffer.resize(offset + sizeof(T));
+	std::memcpy(buffer.data() + offset, &value, sizeof(T));
+}
+
+// copied out rather than cast, the buffer has no alignment guarantees for bullet types
+template <class T>
+inline bool readState(const std::vector<uint8_t>& buffer, size_t& offset, T* value) {
+	if (offset + sizeof(T) > buffer.size())
+		return false;
+
+	std::memcpy(value, buffer.data() + offset, sizeof(T));
+	offset += sizeof(T);
 
-		eventsPtr->emit<ContactEvent>(contactEvent);
+	return true;
+}
+
+// trigger overlaps come from the ghosts' pair caches, so their pairs never need contact points
+inline void skipGhostsNearCallback(btBroadphasePair& pair, btCollisionDispatcher& dispatcher, const btDispatcherInfo& dispatchInfo) {
+	if (btGhostObject::upcast((btCollisionObject*)pair.m_pProxy0->m_clientObject) ||
+		btGhostObject::upcast((btCollisionObject*)pair.m_pProxy1->m_clientObject))
+		return;
+
+	btCollisionDispatcher::defaultNearCallback(pair, dispatcher, dispatchInfo);
+}
+
+inline btRigidBody::btRigidBodyConstructionInfo withMotionState(btRigidBody::btRigidBodyConstructionInfo info, btMotionState* motionState) {
+	info.m_motionState = motionState;
+	return info;
+}
+
+Physics::Body::Body(Collider* collider, const btRigidBody::btRigidBodyConstructionInfo& info) :
+	ColliderMotionState(collider),
+	btRigidBody(withMotionState(info, static_cast<ColliderMotionState*>(this))) {
+}
+
+void Physics::Body::setWorldTransform(const btTransform& worldTransform) {
+	// woken during the step, listed from here since the internal tick only walks listed bodies
+	if (moved || removing || isStaticOrKinematicObject())
+		return;
+
+	// previousTransform is still where it slept
+	currentTransform = btRigidBody::getWorldTransform() * centerOfMassOffset.inverse();
+	settled = false;
+
+	collider->physics->_listMoved(this);
+}
+
+Physics::Ghost::Ghost(Collider* collider) : collider(collider) {
+	if (collider->self.valid() && collider->self.has_component<Transform>()) {
+		transform = collider->self.component<Transform>().get();
+		syncedVersion = transform->version();
+	}
+
+	btTransform worldTransform = btTransform::getIdentity();
+	collider->getWorldTransform(worldTransform);
+
+	setWorldTransform(worldTransform);
+	setCollisionShape(collider->shape);
+	setUserPointer(collider);
+}
+
+void Physics::GhostPairCallback::record(btBroadphaseProxy* ghostProxy, btBroadphaseProxy* otherProxy, bool entering) {
+	btGhostObject* ghostObject = btGhostObject::upcast((btCollisionObject*)ghostProxy->m_clientObject);
+
+	if (!recording || !ghostObject)
+		return;
+
+	Ghost* ghost = static_cast<Ghost*>(ghostObject);
+	const btCollisionObject* otherObject = (btCollisionObject*)otherProxy->m_clientObject;
+	const Collider* otherCollider = (Collider*)otherObject->getUserPointer();
+
+	// bodies pending a batch removal have lost their collider
+	entityx::Entity other = otherCollider ? otherCollider->self : static_cast<const Body*>(btRigidBody::upcast(otherObject))->removedEntity;
+
+	// an enter cancels an exit since the last update and the other way round, so only net changes are listed
+	std::vector<entityx::Entity>& opposite = entering ? ghost->exiting : ghost->entering;
+	auto found = std::find(opposite.begin(), opposite.end(), other);
+
+	if (found != opposite.end()) {
+		*found = opposite.back();
+		opposite.pop_back();
+	}
+	else {
+		(entering ? ghost->entering : ghost->exiting).push_back(other);
+	}
+
+	if (!ghost->pending) {
+		ghost->pending = true;
+		pendingGhosts->push_back(ghost);
 	}
+}
+
+btBroadphasePair* Physics::GhostPairCallback::addOverlappingPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1) {
+	record(proxy0, proxy1, true);
+	record(proxy1, proxy0, true);
+
+	return btGhostPairCallback::addOverlappingPair(proxy0, proxy1);
+}
+
+void* Physics::GhostPairCallback::removeOverlappingPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1, btDispatcher* dispatcher) {
+	record(proxy0, proxy1, false);
+	record(proxy1, proxy0, false);
+
+	return btGhostPairCallback::removeOverlappingPair(proxy0, proxy1, dispatcher);
+}
 
-	eventsPtr->emit<PhysicsUpdateEvent>(PhysicsUpdateEvent{timeStep});
+bool Physics::LayerFilterCallback::needBroadphaseCollision(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1) const {
+	if (!(proxy0->m_collisionFilterGroup & proxy1->m_collisionFilterMask) || !(proxy1->m_collisionFilterGroup & proxy0->m_collisionFilterMask))
+		return false;
+
+	// layers take every group bit, so the static filter bullet would otherwise use is checked here
+	return !((const btCollisionObject*)proxy0->m_clientObject)->isStaticOrKinematicObject() ||
+		!((const btCollisionObject*)proxy1->m_clientObject)->isStaticOrKinematicObject();
 }
 
 Physics::Physics(const ConstructorInfo& constructorInfo) :
-		_defaultGravity(constructorInfo.defaultGravity),
-		_stepsPerUpdate(constructorInfo.stepsPerUpdate),
+		_shapes(constructorInfo.path),
 		_debugLines(constructorInfo.debugLines),
-		_dispatcher(&_collisionConfiguration), 
-		_dynamicsWorld(&_dispatcher, &_overlappingPairCache, &_solver, &_collisionConfiguration) {
+		_defaultGravity(constructorInfo.defaultGravity),
+		_fixedTimestep(constructorInfo.fixedTimestep),
+		_maxSubSteps(constructorInfo.maxSubSteps),
+		_hierarchy(constructorInfo.hierarchy),
+		_workers(constructorInfo.workers),
+		_parallelQueryThreshold(constructorInfo.parallelQueryThreshold),
+		_threaded(constructorInfo.threaded),
+		_lodTiers(constructorInfo.lodTiers) {
+
+	assert(constructorInfo.hierarchy);
+	assert(constructorInfo.fixedTimestep > 0.f && constructorInfo.maxSubSteps > 0);
+	assert(!constructorInfo.lodTiers.empty() && constructorInfo.lodTiers.size() <= 256);
+	assert(std::is_sorted(constructorInfo.lodTiers.begin(), constructorInfo.lodTiers.end(), [](const LodTier& a, const LodTier& b) { return a.distance < b.distance; }));
+	assert(!constructorInfo.layers.empty() && constructorInfo.layers.size() <= 32);
+
+	// every layer pairs with every other until told otherwise
+	for (const CollisionLayer& layer : constructorInfo.layers)
+		_layerNames.push_back(layer.name);
+
+	_layerMasks.assign(_layerNames.size(), btBroadphaseProxy::AllFilter);
+
+	for (uint32_t i = 0; i < constructorInfo.layers.size(); i++) {
+		for (const std::string& ignored : constructorInfo.layers[i].ignores) {
+			auto found = std::find(_layerNames.begin(), _layerNames.end(), ignored);
+
+			if (found == _layerNames.end()) {
+				std::cerr << "System Physics: unknown collision layer " << ignored << " ignored by " << _layerNames[i] << std::endl;
+				continue;
+			}
+
+			const uint32_t j = (uint32_t)(found - _layerNames.begin());
+
+			_layerMasks[i] &= ~(int)(1u << j);
+			_layerMasks[j] &= ~(int)(1u << i);
+		}
+	}
+
+	_broadphase = createBroadphase(constructorInfo.broadphase);
+
+	if (constructorInfo.broadphase.type == BroadphaseInfo::Dbvt)
+		_dbvt = static_cast<btDbvtBroadphase*>(_broadphase.get());
+
+	// bullet only takes its scheduler from the thread it numbers first, and indexes per thread slots by whoever steps,
+	// so a world stepped from the physics thread has to stay sequential
+	if (constructorInfo.threadCount > 1 && _threaded)
+		std::cerr << "System Physics: thread count ignored when stepping on the physics thread, using sequential world" << std::endl;
+
+	if (constructorInfo.threadCount > 1 && !_threaded) {
+		// bullet's scheduler is global, returns null when bullet is built without BT_THREADSAFE
+		_taskScheduler.reset(btCreateDefaultTaskScheduler());
+
+		if (!_taskScheduler)
+			std::cerr << "System Physics: bullet built without BT_THREADSAFE, using sequential world" << std::endl;
+	}
+
+	if (_taskScheduler) {
+		_taskScheduler->setNumThreads(constructorInfo.threadCount);
+		btSetTaskScheduler(_taskScheduler.get());
+
+		_dispatcher = std::make_unique<btCollisionDispatcherMt>(&_collisionConfiguration);
+		_solverPool = std::make_unique<btConstraintSolverPoolMt>(_taskScheduler->getNumThreads());
+		_solver = std::make_unique<btSequentialImpulseConstraintSolverMt>();
+		_dynamicsWorld = std::make_unique<btDiscreteDynamicsWorldMt>(_dispatcher.get(), _broadphase.get(), _solverPool.get(), _solver.get(), &_collisionConfiguration);
+	}
+	else {
+		_dispatcher = std::make_unique<btCollisionDispatcher>(&_collisionConfiguration);
+		_solver = std::make_unique<btSequentialImpulseConstraintSolver>();
+		_dynamicsWorld = std::make_unique<btDiscreteDynamicsWorld>(_dispatcher.get(), _broadphase.get(), _solver.get(), &_collisionConfiguration);
+	}
 	
 	if (_debugLines)
-		_dynamicsWorld.setDebugDrawer(&_debugger);
+		_dynamicsWorld->setDebugDrawer(&_debugger);
 
 	setGravity(_defaultGravity);
 
-	_dynamicsWorld.setInternalTickCallback(&internalTickCallback, 0);
+	// only awake objects get their bounds refreshed each step, anything moved while asleep is refreshed where it's moved
+	_dynamicsWorld->setForceUpdateAllAabbs(false);
+
+	_dynamicsWorld->setInternalTickCallback(&Physics::_internalTick, this);
+
+	_ghostPairs.pendingGhosts = &_pendingGhosts;
+	_broadphase->getOverlappingPairCache()->setInternalGhostPairCallback(&_ghostPairs);
+	_broadphase->getOverlappingPairCache()->setOverlapFilterCallback(&_layerFilter);
+	_dispatcher->setNearCallback(&skipGhostsNearCallback);
 
 	gContactStartedCallback = contactCallback<true>;
 	gContactEndedCallback = contactCallback<false>;
+
+	if (_threaded) {
+		_running = true;
+		_thread = std::thread(&Physics::_threadLoop, this);
+	}
+}
+
+Physics::~Physics() {
+	// colliders waiting on a batch have no body to remove, bodies removed in one still need to leave the world
+	_pendingAttach.clear();
+	endBatch();
+
+	if (_thread.joinable()) {
+		_running = false;
+		_thread.join();
+	}
+
+	_ghostPairs.recording = false;
+
+	// bodies still in the world belong to colliders that outlive the system
+	auto& objects = _dynamicsWorld->getCollisionObjectArray();
+
+	for (int i = objects.size() - 1; i >= 0; i--) {
+		btRigidBody* rigidBody = btRigidBody::upcast(objects[i]);
+		btGhostObject* ghostObject = btGhostObject::upcast(objects[i]);
+
+		_dynamicsWorld->removeCollisionObject(objects[i]);
+
+		if (rigidBody) {
+			for (Collider* part : static_cast<Body*>(rigidBody)->parts) {
+				part->compoundRoot = nullptr;
+				part->rigidBody = nullptr;
+			}
+
+			((Collider*)rigidBody->getUserPointer())->rigidBody = nullptr;
+			_bodies.destroy(static_cast<Body*>(rigidBody));
+		}
+		else if (ghostObject) {
+			((Collider*)ghostObject->getUserPointer())->ghostObject = nullptr;
+			_ghosts.destroy(static_cast<Ghost*>(ghostObject));
+		}
+	}
+
+	_dynamicsWorld.reset();
+	_broadphase->getOverlappingPairCache()->setInternalGhostPairCallback(nullptr);
+	_broadphase->getOverlappingPairCache()->setOverlapFilterCallback(nullptr);
+
+	if (_taskScheduler)
+		btSetTaskScheduler(btGetSequentialTaskScheduler());
 }
 
 void Physics::configure(entityx::EventManager & events){
 	events.subscribe<entityx::ComponentAddedEvent<Collider>>(*this);
 	events.subscribe<entityx::ComponentRemovedEvent<Collider>>(*this);
+	events.subscribe<entityx::ComponentRemovedEvent<Transform>>(*this);
 
 	eventsPtr = &events;
 }
 
 void Physics::update(entityx::EntityManager & entities, entityx::EventManager & events, double dt){
-	// Step the simulation
-	for (uint32_t i = 0; i < _stepsPerUpdate; i++)
-		_dynamicsWorld.stepSimulation(dt / _stepsPerUpdate, 0);
+	endBatch();
+
+	if (_threaded) {
+		_sync(events);
+		return;
+	}
+
+	_rebuildCompounds();
+	_updateLod();
+	_pushKinematic();
+
+	// Step the simulation at a fixed rate, counted here rather than from bullet's own local time so restoreState can rewind it
+	_accumulator += (btScalar)dt;
+
+	uint32_t steps = (uint32_t)(_accumulator / _fixedTimestep);
+	_accumulator -= steps * _fixedTimestep;
+
+	// time past the last allowed step is dropped, like stepSimulation does
+	steps = std::min(steps, _maxSubSteps);
+
+	for (uint32_t i = 0; i < steps; i++)
+		_dynamicsWorld->stepSimulation(_fixedTimestep, 0);
+
+	// Write bodies that moved, blended between the last two fixed steps
+	_pullMoved(_accumulator / _fixedTimestep);
+
+	_publishTriggers();
+
+	_gatherContacts(_listedContacts);
+	_buildContactStream(_listedContacts);
+	events.emit<ContactStreamEvent>(ContactStreamEvent{ &_contactStream });
 	
 	// Draw bullet world
 	if (_debugLines) {
 		_debugger.clearLines();
-		_dynamicsWorld.debugDrawWorld();
+		_dynamicsWorld->debugDrawWorld();
 	}
 }
 
-void Physics::receive(const entityx::ComponentAddedEvent<Collider>& colliderAddedEvent) {
-	auto collider = colliderAddedEvent.component;
+void Physics::_internalTick(btDynamicsWorld* world, btScalar timeStep) {
+	Physics* physics = (Physics*)world->getWorldUserInfo();
 
-	collider->self = colliderAddedEvent.entity;
+	// shift fixed step states for interpolation, the list keeps awake bodies between steps so sleeping piles cost nothing here
+	auto& moved = physics->_movedBodies;
 
-	btTransform shapeTransform;
-	shapeTransform.setIdentity();
+	for (size_t i = 0; i < moved.size();) {
+		Body* body = moved[i];
+		btRigidBody* rigidBody = body;
 
-	const Collider::ShapeInfo& shapeInfo = collider->shapeInfo;
+		if (rigidBody->isActive()) {
+			body->previousTransform = body->currentTransform;
+			body->currentTransform = rigidBody->getWorldTransform() * body->centerOfMassOffset.inverse();
+			body->settled = false;
+		}
+		else if (!body->settled) {
+			// fell asleep, listed once more so it comes to rest on its last state
+			body->currentTransform = rigidBody->getWorldTransform() * body->centerOfMassOffset.inverse();
+			body->previousTransform = body->currentTransform;
+			body->settled = true;
+		}
+		else {
+			// the last body takes its slot
+			physics->_removeMoved(body);
+			continue;
+		}
 
-	switch (collider->shapeInfo.type) {
-	case Collider::Sphere:
-		collider->shapeVariant = btSphereShape(shapeInfo.a * .5f);
-		break;
-	case Collider::Box:
-		collider->shapeVariant = btBoxShape(btVector3(shapeInfo.a * .5f, shapeInfo.b * .5f, shapeInfo.c * .5f));
-		break;
-	case Collider::Plane:
-		collider->shapeVariant = btStaticPlaneShape(btVector3(0, 0, 1), 1);
-		break;
-	case Collider::Capsule:
-		collider->shapeVariant = btCapsuleShapeZ(shapeInfo.a * .5f, shapeInfo.b);
-		break;
-	case Collider::Cylinder:
-		collider->shapeVariant = btCylinderShapeZ(btVector3(shapeInfo.a * .5f, shapeInfo.a * .5f, shapeInfo.b * .5f));
-		break;
-	case Collider::Cone:
-		collider->shapeVariant = btConeShapeZ(shapeInfo.a * .5f, shapeInfo.b);
-		break;
+		i++;
+	}
+
+	// threaded steps are counted into the step output and emitted at the next sync instead
+	if (!physics->_threaded)
+		eventsPtr->emit<PhysicsUpdateEvent>(PhysicsUpdateEvent{timeStep});
+}
+
+void Physics::_pushKinematic() {
+	for (Body* body : _kinematicBodies) {
+		if (!body->transform)
+			continue;
+
+		// read through the Transform's own cache, the version belongs to it
+		const uint32_t version = body->transform->version();
+
+		if (version == body->syncedVersion)
+			continue;
+
+		body->syncedVersion = version;
+
+		glm::vec3 globalPosition;
+		glm::quat globalRotation;
+
+		body->transform->globalDecomposed(&globalPosition, &globalRotation);
+
+		// bullet reads this through the motion state when saving kinematic states
+		const btTransform worldTransform(toBt(globalRotation), toBt(globalPosition));
+
+		if (_threaded)
+			command(body, [body, worldTransform] { body->currentTransform = worldTransform; });
+		else
+			body->currentTransform = worldTransform;
 	}
 
-	btCollisionShape* shape;
+	for (Ghost* ghost : _movingGhosts) {
+		if (!ghost->transform)
+			continue;
+
+		const uint32_t version = ghost->transform->version();
+
+		if (version == ghost->syncedVersion)
+			continue;
+
+		ghost->syncedVersion = version;
 
-	std::visit([&](btCollisionShape& visitShape) {
-		shape = &visitShape;
-	}, collider->shapeVariant);
+		glm::vec3 globalPosition;
+		glm::quat globalRotation;
 
-	if (colliderAddedEvent.entity.has_component<Transform>() && collider->shapeInfo.type != Collider::Plane) {
-		auto transform = colliderAddedEvent.entity.component<const Transform>();
+		ghost->transform->globalDecomposed(&globalPosition, &globalRotation);
 
-		glm::vec3 globalScale;
-		transform->globalDecomposed(nullptr, nullptr, &globalScale);
+		// moving ghosts never sleep, so bullet refreshes their bounds each step
+		const btTransform worldTransform(toBt(globalRotation), toBt(globalPosition));
 
-		shape->setLocalScaling(toBt(globalScale));
+		if (_threaded)
+			command(ghost, [ghost, worldTransform] { ghost->setWorldTransform(worldTransform); });
+		else
+			ghost->setWorldTransform(worldTransform);
 	}
+}
 
-	btVector3 localInertia(0.f, 0.f, 0.f);
+void Physics::_clearTriggers() {
+	for (Ghost* ghost : _publishedGhosts) {
+		ghost->entered.clear();
+		ghost->exited.clear();
+	}
 
-	if (collider->bodyInfo.mass != 0.f)
-		shape->calculateLocalInertia(collider->bodyInfo.mass, localInertia);
+	_publishedGhosts.clear();
+	_changedTriggers.clear();
+}
 
-	btRigidBody::btRigidBodyConstructionInfo rigidBodyInfo(collider->bodyInfo.mass, (btMotionState*)collider.get(), shape, localInertia);
-	
-	rigidBodyInfo.m_linearSleepingThreshold = 32;
-	rigidBodyInfo.m_angularSleepingThreshold = 32;
+void Physics::_publishTriggers() {
+	_clearTriggers();
 
-	rigidBodyInfo.m_friction = collider->bodyInfo.defaultFriction;
-	rigidBodyInfo.m_rollingFriction = collider->bodyInfo.defaultRollingFriction;
-	rigidBodyInfo.m_spinningFriction = collider->bodyInfo.defaultSpinningFriction;
+	// includes changes from bodies added or removed between updates
+	for (Ghost* ghost : _pendingGhosts) {
+		ghost->pending = false;
 
-	rigidBodyInfo.m_linearDamping = collider->bodyInfo.defaultLinearDamping;
-	rigidBodyInfo.m_angularDamping = collider->bodyInfo.defaultAngularDamping;
+		if (ghost->entering.empty() && ghost->exiting.empty())
+			continue;
 
-	rigidBodyInfo.m_restitution = collider->bodyInfo.defaultRestitution;
+		std::swap(ghost->entered, ghost->entering);
+		std::swap(ghost->exited, ghost->exiting);
 
-	collider->rigidBody = btRigidBody(rigidBodyInfo);
-	collider->rigidBody.setUserPointer(collider.get());
+		_publishedGhosts.push_back(ghost);
+		_changedTriggers.push_back(ghost->collider->self);
+	}
 
-	switch (collider->bodyInfo.type) {
-	case Collider::Trigger:
-		collider->rigidBody.setCollisionFlags(btCollisionObject::CollisionFlags::CF_NO_CONTACT_RESPONSE);
-		break;
-	case Collider::StaticTrigger:
-		collider->rigidBody.setCollisionFlags(btCollisionObject::CollisionFlags::CF_NO_CONTACT_RESPONSE | btCollisionObject::CollisionFlags::CF_STATIC_OBJECT);
-		break;
-	case Collider::Static:
-		collider->rigidBody.setCollisionFlags(btCollisionObject::CollisionFlags::CF_STATIC_OBJECT);
-		break;
-	case Collider::Kinematic:
-		collider->rigidBody.setCollisionFlags(btCollisionObject::CollisionFlags::CF_KINEMATIC_OBJECT);
-		break;
+	_pendingGhosts.clear();
+}
+
+void Physics::_pullMoved(btScalar alpha) {
+	for (Body* body : _movedBodies)
+		body->interpolate(alpha);
+}
+
+void Physics::_listMoved(Body* body) {
+	body->moved = true;
+	body->movedSlot = (uint32_t)_movedBodies.size();
+	_movedBodies.push_back(body);
+}
+
+void Physics::_removeMoved(Body* body) {
+	if (!body->moved)
+		return;
+
+	body->moved = false;
+	_movedBodies[body->movedSlot] = _movedBodies.back();
+	_movedBodies[body->movedSlot]->movedSlot = body->movedSlot;
+	_movedBodies.pop_back();
+}
+
+void Physics::_updateLod() {
+	if (_lodTiers.size() < 2 || !_lodFocus.valid() || !_lodFocus.has_component<Transform>())
+		return;
+
+	glm::vec3 focus;
+	_hierarchy->globalDecomposed(_lodFocus, &focus);
+
+	const btVector3 lodFocus = toBt(focus);
+	command(nullptr, [this, lodFocus] { _updateLod(lodFocus); });
+}
+
+void Physics::_updateLod(const btVector3& focus) {
+	const auto& bodies = _dynamicsWorld->getNonStaticRigidBodies();
+
+	for (int i = 0; i < bodies.size(); i++) {
+		if (bodies[i]->isKinematicObject())
+			continue;
+
+		const btScalar distance2 = bodies[i]->getWorldTransform().getOrigin().distance2(focus);
+
+		uint8_t tier = 0;
+
+		while (tier + 1u < _lodTiers.size() && distance2 > _lodTiers[tier + 1].distance * _lodTiers[tier + 1].distance)
+			tier++;
+
+		ColliderMotionState* motionState = (ColliderMotionState*)bodies[i]->getMotionState();
+
+		if (tier == motionState->lodTier)
+			continue;
+
+		const bool wasFrozen = _lodTiers[motionState->lodTier].frozen;
+		motionState->lodTier = tier;
+
+		const LodTier& lodTier = _lodTiers[tier];
+		bodies[i]->setSleepingThresholds(lodTier.linearSleepingThreshold, lodTier.angularSleepingThreshold);
+
+		// always active bodies keep simulating in frozen tiers, they'd only lose their velocity
+		if (bodies[i]->getActivationState() == DISABLE_DEACTIVATION)
+			continue;
+
+		if (lodTier.frozen) {
+			bodies[i]->setLinearVelocity(btVector3(0, 0, 0));
+			bodies[i]->setAngularVelocity(btVector3(0, 0, 0));
+			bodies[i]->setActivationState(ISLAND_SLEEPING);
+		}
+		else if (wasFrozen) {
+			bodies[i]->activate();
+		}
 	}
+}
 
-	collider->setAngularFactor(collider->bodyInfo.defaultAngularFactor);
-	collider->setLinearFactor(collider->bodyInfo.defaultLinearFactor);
-	collider->setAngularVelocity(collider->bodyInfo.startingAngularVelocity);
-	collider->setLinearVelocity(collider->bodyInfo.startingLinearVelocity);
+void Physics::_gatherContacts(std::vector<ListedContact>& contacts) const {
+	contacts.clear();
 
-	if (collider->bodyInfo.alwaysActive)
-		collider->setAlwaysActive(true);
+	// manifolds as they stand after the last substep
+	btDispatcher* dispatcher = _dynamicsWorld->getDispatcher();
 
-	if (collider->bodyInfo.callbacks)
-		collider->rigidBody.setCollisionFlags(collider->rigidBody.getCollisionFlags() | btCollisionObject::CollisionFlags::CF_CUSTOM_MATERIAL_CALLBACK);
+	for (int i = 0; i < dispatcher->getNumManifolds(); i++) {
+		const btPersistentManifold* manifold = dispatcher->getManifoldByIndexInternal(i);
+
+		const Collider* firstCollider = (Collider*)manifold->getBody0()->getUserPointer();
+		const Collider* secondCollider = (Collider*)manifold->getBody1()->getUserPointer();
+
+		if ((!firstCollider->bodyInfo.callbacks && !secondCollider->bodyInfo.callbacks) ||
+			(!manifold->getBody0()->isActive() && !manifold->getBody1()->isActive()))
+			continue;
+
+		ListedContact contact;
+		contact.event.firstEntity = firstCollider->self;
+		contact.event.secondEntity = secondCollider->self;
+
+		const float impulse = readManifold(manifold, &contact.event);
 
-	_dynamicsWorld.addRigidBody(&collider->rigidBody);
+		if (impulse == 0)
+			continue;
+
+		contact.firstListed = firstCollider->bodyInfo.callbacks && impulse >= firstCollider->bodyInfo.contactImpulseThreshold;
+		contact.secondListed = secondCollider->bodyInfo.callbacks && impulse >= secondCollider->bodyInfo.contactImpulseThreshold;
+
+		if (contact.firstListed || contact.secondListed)
+			contacts.push_back(contact);
+	}
 }
 
-void Physics::receive(const entityx::ComponentRemovedEvent<Collider>& colliderRemovedEvent){
-	auto collider = colliderRemovedEvent.component;
+void Physics::_buildContactStream(const std::vector<ListedContact>& contacts) {
+	_contactStream.clear();
+
+	// starts and ends queued by the narrowphase since the last update, bodies may have been removed since
+	{
+		std::lock_guard<std::mutex> lock(pendingCollidingLock);
 
-	_dynamicsWorld.removeRigidBody(&collider->rigidBody);
+		for (const auto& collidingEvent : pendingColliding)
+			_contactStream.addColliding(collidingEvent, listsContacts(collidingEvent.firstEntity), listsContacts(collidingEvent.secondEntity));
+
+		pendingColliding.clear();
+	}
+
+	for (const ListedContact& contact : contacts)
+		_contactStream.addContact(contact.event, contact.firstListed, contact.secondListed);
+
+	_contactStream.build();
 }
 
-void Physics::setGravity(const glm::vec3 & gravity) {
-	_dynamicsWorld.setGravity(toBt(gravity));
+void Physics::command(const btCollisionObject* object, const std::function<void()>& apply) {
+	if (!_threaded) {
+		apply();
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(_commandMutex);
+	_commands.push_back(Command{ object, apply });
 }
 
-void Physics::rayTest(const glm::vec3& from, const glm::vec3& to, std::vector<entityx::Entity>& hits){
-	btVector3 bFrom(toBt(from));
-	btVector3 bTo(toBt(to));
+bool Physics::threaded() const {
+	return _threaded;
+}
+
+std::unique_lock<std::mutex> Physics::_lockWorld() const {
+	// a batch holds the world until it ends
+	if (!_threaded || _batching)
+		return std::unique_lock<std::mutex>(_worldMutex, std::defer_lock);
+
+	return std::unique_lock<std::mutex>(_worldMutex);
+}
+
+void Physics::_threadLoop() {
+	using Clock = std::chrono::steady_clock;
+
+	const Clock::duration step = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(_fixedTimestep));
+	Clock::time_point nextStep = Clock::now() + step;
+
+	while (_running) {
+		std::this_thread::sleep_until(nextStep);
+
+		// catches up on missed steps, unless it fell further behind than maxSubSteps
+		const Clock::time_point now = Clock::now();
 
-	btCollisionWorld::AllHitsRayResultCallback results(bFrom, bTo);
+		if (now - nextStep > step * (int)_maxSubSteps)
+			nextStep = now;
 
-	results.m_flags |= btTriangleRaycastCallback::kF_KeepUnflippedNormal;
-	results.m_flags |= btTriangleRaycastCallback::kF_UseSubSimplexConvexCastRaytest;
+		nextStep += step;
 
-	_dynamicsWorld.rayTest(bFrom, bTo, results);
+		std::lock_guard<std::mutex> lock(_worldMutex);
 
-	hits.reserve(results.m_collisionObjects.size());
+		_runCommands();
 
-	for (uint32_t i = 0; i < results.m_collisionObjects.size(); i++) {
-		Collider* collider = (Collider*)results.m_collisionObjects[i]->getUserPointer();
-		hits.push_back(collider->self);
+		// exactly one step of fixedTimestep, interpolation is done at the sync from the step output
+		_dynamicsWorld->stepSimulation(_fixedTimestep, 0);
+
+		_writeOutput();
 	}
 }
 
-const BulletDebug & Physics::bulletDebug() const{
-	return _debugger;
+void Physics::_runCommands() {
+	{
+		std::lock_guard<std::mutex> lock(_commandMutex);
+		std::swap(_runningCommands, _commands);
+	}
+
+	for (const Command& command : _runningCommands)
+		command.apply();
+
+	_runningCommands.clear();
+}
+
+void Physics::_writeOutput() {
+	// under the world lock only, so the sync isn't kept waiting on the manifolds
+	_gatherContacts(_stepContacts);
+
+	std::lock_guard<std::mutex> lock(_outputMutex);
+
+	StepOutput& output = _outputs[1 - _frontOutput];
+
+	// bodies moving over several steps between syncs keep one entry, holding their last two states
+	for (Body* body : _movedBodies) {
+		if (body->outputGeneration != _outputGeneration) {
+			body->outputGeneration = _outputGeneration;
+			body->outputSlot = (uint32_t)output.moved.size();
+			output.moved.emplace_back();
+		}
+
+		StepOutput::Moved& moved = output.moved[body->outputSlot];
+		moved.body = body;
+		moved.previousTransform = body->previousTransform;
+		moved.currentTransform = body->currentTransform;
+		moved.linearVelocity = body->getLinearVelocity();
+		moved.angularVelocity = body->getAngularVelocity();
+	}
+
+	std::swap(output.contacts, _stepContacts);
+	output.steps++;
+
+	_lastStepTime = std::chrono::steady_clock::now();
+}
+
+void Physics::_sync(entityx::EventManager& events) {
+	// swap in what the physics thread wrote since the last sync
+	{
+		std::lock_guard<std::mutex> lock(_outputMutex);
+
+		_frontOutput = 1 - _frontOutput;
+		_outputGeneration++;
+		_syncedStepTime = _lastStepTime;
+	}
+
+	StepOutput& output = _outputs[_frontOutput];
+
+	// without steps the last ones are blended further instead
+	if (output.steps) {
+		std::swap(_syncedMoved, output.moved);
+		std::swap(_listedContacts, output.contacts);
+
+		for (const StepOutput::Moved& moved : _syncedMoved) {
+			moved.body->syncedLinearVelocity = moved.linearVelocity;
+			moved.body->syncedAngularVelocity = moved.angularVelocity;
+		}
+	}
+
+	const uint32_t steps = output.steps;
+
+	// handed back empty, bodies in it may be gone by the next sync
+	output.moved.clear();
+	output.contacts.clear();
+	output.steps = 0;
+
+	// shown one step behind, blending towards the last step as the next one comes due
+	const double sinceStep = std::chrono::duration<double>(std::chrono::steady_clock::now() - _syncedStepTime).count();
+	const btScalar alpha = btClamped((btScalar)(sinceStep / _fixedTimestep), btScalar(0), btScalar(1));
+
+	for (const StepOutput::Moved& moved : _syncedMoved)
+		moved.body->interpolate(moved.previousTransform, moved.currentTransform, alpha);
+
+	for (uint32_t i = 0; i < steps; i++)
+		events.emit<PhysicsUpdateEvent>(PhysicsUpdateEvent{ _fixedTimestep });
+
+	_buildContactStream(_listedContacts);
+	events.emit<ContactStreamEvent>(ContactStreamEvent{ &_contactStream });
+
+	// after the handlers, so what they moved reaches the next step instead of the one after
+	_updateLod();
+	_pushKinematic();
+
+	// the rest reads the world, left to a later sync rather than waiting out a step
+	std::unique_lock<std::mutex> worldLock(_worldMutex, std::try_to_lock);
+
+	if (!worldLock.owns_lock()) {
+		_clearTriggers();
+		return;
+	}
+
+	_rebuildCompounds();
+	_publishTriggers();
+
+	if (_debugLines) {
+		_debugger.clearLines();
+		_dynamicsWorld->debugDrawWorld();
+	}
+}
+
+void Physics::_dropCommands(const std::function<bool(const btCollisionObject*)>& dropped) {
+	std::lock_guard<std::mutex> lock(_commandMutex);
+
+	_commands.erase(std::remove_if(_commands.begin(), _commands.end(), [&](const Command& command) {
+		return command.object && dropped(command.object);
+	}), _commands.end());
+}
+
+void Physics::_dropOutputs(const std::function<bool(const Body*)>& dropped) {
+	_syncedMoved.erase(std::remove_if(_syncedMoved.begin(), _syncedMoved.end(), [&](const StepOutput::Moved& moved) {
+		return dropped(moved.body);
+	}), _syncedMoved.end());
+
+	std::lock_guard<std::mutex> lock(_outputMutex);
+
+	// bodies that stay are listed afresh by the next step
+	StepOutput& output = _outputs[1 - _frontOutput];
+	uint32_t kept = 0;
+
+	for (uint32_t i = 0; i < output.moved.size(); i++) {
+		Body* body = output.moved[i].body;
+
+		if (dropped(body)) {
+			body->outputGeneration = 0;
+			continue;
+		}
+
+		body->outputSlot = kept;
+		output.moved[kept++] = output.moved[i];
+	}
+
+	output.moved.resize(kept);
+}
+
+void Physics::receive(const entityx::ComponentAddedEvent<Collider>& colliderAddedEvent) {
+	auto collider = colliderAddedEvent.component;
+
+	collider->self = colliderAddedEvent.entity;
+	collider->hierarchy = _hierarchy;
+	collider->physics = this;
+
+	glm::vec3 globalScale(1.f);
+
+	if (colliderAddedEvent.entity.has_component<Transform>())
+		_hierarchy->globalDecomposed(colliderAddedEvent.entity, nullptr, nullptr, &globalScale);
+
+	collider->shape = _shapes.acquire(collider->shapeInfo, globalScale);
+	btCollisionShape* shape = collider->shape;
+
+	if (!shape) {
+		std::cerr << "System Physics: couldn't create shape for collider" << std::endl;
+		return;
+	}
+
+	if (_batching && collider->bodyInfo.type != Collider::Trigger && collider->bodyInfo.type != Collider::StaticTrigger) {
+		_pendingAttach.push_back(collider.get());
+		return;
+	}
+
+	auto worldLock = _lockWorld();
+
+	if (collider->bodyInfo.type == Collider::Trigger || collider->bodyInfo.type == Collider::StaticTrigger)
+		_addTrigger(collider.get());
+	else
+		_attach(collider.get());
+}
+
+void Physics::receive(const entityx::ComponentRemovedEvent<Collider>& colliderRemovedEvent){
+	auto collider = colliderRemovedEvent.component;
+	auto worldLock = _lockWorld();
+
+	if (collider->ghostObject) {
+		_removeTrigger(collider.get());
+		return;
+	}
+
+	if (collider->compoundRoot) {
+		_removePart(collider.get());
+
+		// the compound keeps using it until rebuilt
+		_releasedShapes.push_back(collider->shape);
+		collider->shape = nullptr;
+		return;
+	}
+
+	if (!collider->rigidBody) {
+		// added and removed inside the same batch
+		auto pending = std::find(_pendingAttach.begin(), _pendingAttach.end(), collider.get());
+
+		if (pending != _pendingAttach.end()) {
+			*pending = _pendingAttach.back();
+			_pendingAttach.pop_back();
+
+			_shapes.release(collider->shape);
+			collider->shape = nullptr;
+		}
+
+		return;
+	}
+
+	Body* body = static_cast<Body*>(collider->rigidBody);
+	std::vector<Collider*> parts = std::move(body->parts);
+
+	_removeBody(body);
+
+	// bodies removed in a batch keep their shape until endBatch
+	if (_batching)
+		_releasedShapes.push_back(collider->shape);
+	else
+		_shapes.release(collider->shape);
+
+	collider->shape = nullptr;
+
+	// parts left behind get bodies of their own, merging again under any collider still above them
+	for (Collider* part : parts) {
+		part->compoundRoot = nullptr;
+		part->rigidBody = nullptr;
+	}
+
+	for (Collider* part : parts) {
+		if (_batching)
+			_pendingAttach.push_back(part);
+		else if (!part->rigidBody)
+			_attach(part);
+	}
+}
+
+void Physics::receive(const entityx::ComponentRemovedEvent<Transform>& transformRemovedEvent) {
+	entityx::Entity entity = transformRemovedEvent.entity;
+
+	if (!entity.has_component<Collider>())
+		return;
+
+	auto collider = entity.component<Collider>();
+
+	// parts don't sync, their body is the root's
+	if (collider->compoundRoot)
+		return;
+
+	// the collider may outlive its Transform, stop syncing through the cached pointer
+	if (collider->rigidBody)
+		static_cast<Body*>(collider->rigidBody)->transform = nullptr;
+	else if (collider->ghostObject)
+		static_cast<Ghost*>(collider->ghostObject)->transform = nullptr;
+}
+
+Collider* Physics::_compoundRoot(entityx::Entity entity) const {
+	if (!entity.has_component<Transform>())
+		return nullptr;
+
+	entityx::Entity parent = entity.component<Transform>()->parent();
+
+	// nearest ancestor with a body, triggers are passed over
+	while (parent.valid() && parent.has_component<Transform>()) {
+		if (parent.has_component<Collider>()) {
+			Collider* collider = parent.component<Collider>().get();
+
+			if (collider->rigidBody)
+				return collider->compoundRoot ? collider->compoundRoot : collider;
+		}
+
+		parent = parent.component<Transform>()->parent();
+	}
+
+	return nullptr;
+}
+
+void Physics::_attach(Collider* collider) {
+	// colliders below another collider's body become parts of it
+	if (Collider* root = _compoundRoot(collider->self)) {
+		_addPart(root, collider);
+		return;
+	}
+
+	_addBody(collider);
+
+	if (!collider->self.has_component<Transform>())
+		return;
+
+	// bodies added below this one earlier are merged into it, parts and all
+	for (entityx::Entity entity : Transform::subtree(collider->self)) {
+		if (entity == collider->self || !entity.has_component<Collider>())
+			continue;
+
+		Collider* below = entity.component<Collider>().get();
+
+		if (!below->rigidBody || below->compoundRoot)
+			continue;
+
+		Body* body = static_cast<Body*>(below->rigidBody);
+		std::vector<Collider*> parts = std::move(body->parts);
+
+		_removeBody(body);
+		_addPart(collider, below);
+
+		for (Collider* part : parts)
+			_addPart(collider, part);
+	}
+}
+
+void Physics::_addBody(Collider* collider) {
+	btCollisionShape* shape = collider->shape;
+	float mass = collider->bodyInfo.mass;
+
+	// triangle meshes have no inertia, they can only be static
+	if (shape->isConcave() && mass != 0.f) {
+		std::cerr << "System Physics: mesh colliders have to be static, mass ignored" << std::endl;
+		mass = 0.f;
+	}
+
+	btVector3 localInertia(0.f, 0.f, 0.f);
+
+	if (mass != 0.f)
+		shape->calculateLocalInertia(mass, localInertia);
+
+	btRigidBody::btRigidBodyConstructionInfo rigidBodyInfo(mass, nullptr, shape, localInertia);
+	
+	rigidBodyInfo.m_linearSleepingThreshold = _lodTiers[0].linearSleepingThreshold;
+	rigidBodyInfo.m_angularSleepingThreshold = _lodTiers[0].angularSleepingThreshold;
+
+	rigidBodyInfo.m_friction = collider->bodyInfo.defaultFriction;
+	rigidBodyInfo.m_rollingFriction = collider->bodyInfo.defaultRollingFriction;
+	rigidBodyInfo.m_spinningFriction = collider->bodyInfo.defaultSpinningFriction;
+
+	rigidBodyInfo.m_linearDamping = collider->bodyInfo.defaultLinearDamping;
+	rigidBodyInfo.m_angularDamping = collider->bodyInfo.defaultAngularDamping;
+
+	rigidBodyInfo.m_restitution = collider->bodyInfo.defaultRestitution;
+
+	Body* body = _bodies.create(collider, rigidBodyInfo);
+	body->setUserPointer(collider);
+
+	collider->rigidBody = body;
+
+	switch (collider->bodyInfo.type) {
+	case Collider::Static:
+		collider->rigidBody->setCollisionFlags(btCollisionObject::CollisionFlags::CF_STATIC_OBJECT);
+		break;
+	case Collider::Kinematic:
+		collider->rigidBody->setCollisionFlags(btCollisionObject::CollisionFlags::CF_KINEMATIC_OBJECT);
+
+		body->kinematicSlot = (uint32_t)_kinematicBodies.size();
+		_kinematicBodies.push_back(body);
+		break;
+	default:
+		// starts awake, unless massless
+		if (!body->isStaticObject())
+			_listMoved(body);
+		break;
+	}
+
+	collider->setAngularFactor(collider->bodyInfo.defaultAngularFactor);
+	collider->setLinearFactor(collider->bodyInfo.defaultLinearFactor);
+	collider->setAngularVelocity(collider->bodyInfo.startingAngularVelocity);
+	collider->setLinearVelocity(collider->bodyInfo.startingLinearVelocity);
+
+	if (collider->bodyInfo.alwaysActive)
+		collider->setAlwaysActive(true);
+
+	if (collider->bodyInfo.callbacks)
+		collider->rigidBody->setCollisionFlags(collider->rigidBody->getCollisionFlags() | btCollisionObject::CollisionFlags::CF_CUSTOM_MATERIAL_CALLBACK);
+
+	collider->layer = collider->bodyInfo.layer.empty() ? 0 : _layerIndex(collider->bodyInfo.layer);
+
+	_dynamicsWorld->addRigidBody(body, (int)(1u << collider->layer), _layerMasks[collider->layer]);
+
+	// moving bodies centred off their origin hold their shape in a compound, shifted by the next rebuild
+	if (!body->isStaticOrKinematicObject() && collider->bodyInfo.centerOfMass != glm::vec3(0.f)) {
+		body->compoundDirty = true;
+		_dirtyCompounds.push_back(body);
+	}
+}
+
+void Physics::_removeBody(Body* body) {
+	if (body->isKinematicObject()) {
+		_kinematicBodies[body->kinematicSlot] = _kinematicBodies.back();
+		_kinematicBodies[body->kinematicSlot]->kinematicSlot = body->kinematicSlot;
+		_kinematicBodies.pop_back();
+	}
+	else if (!_batching) {
+		_removeMoved(body);
+	}
+
+	if (body->compoundDirty)
+		_dirtyCompounds.erase(std::find(_dirtyCompounds.begin(), _dirtyCompounds.end(), body));
+
+	body->collider->rigidBody = nullptr;
+
+	if (_batching) {
+		// the collider is destroyed before the batch ends
+		body->removing = true;
+		body->removedEntity = body->collider->self;
+		body->collider = nullptr;
+		body->transform = nullptr;
+		body->setUserPointer(nullptr);
+
+		// still in the broadphase, filtered out of every query and new pair until it leaves
+		btBroadphaseProxy* proxy = body->getBroadphaseHandle();
+		proxy->m_collisionFilterGroup = 0;
+		proxy->m_collisionFilterMask = 0;
+
+		_pendingRemovals.push_back(body);
+		return;
+	}
+
+	if (_threaded) {
+		_dropCommands([body](const btCollisionObject* object) { return object == body; });
+		_dropOutputs([body](const Body* moved) { return moved == body; });
+	}
+
+	_dynamicsWorld->removeRigidBody(body);
+	_bodies.destroy(body);
+}
+
+void Physics::_removePending() {
+	auto removing = [](const Body* body) { return body->removing; };
+
+	_movedBodies.erase(std::remove_if(_movedBodies.begin(), _movedBodies.end(), removing), _movedBodies.end());
+
+	for (uint32_t i = 0; i < _movedBodies.size(); i++)
+		_movedBodies[i]->movedSlot = i;
+
+	if (_threaded) {
+		_dropCommands([](const btCollisionObject* object) {
+			const btRigidBody* rigidBody = btRigidBody::upcast(object);
+			return rigidBody && static_cast<const Body*>(rigidBody)->removing;
+		});
+
+		_dropOutputs(removing);
+	}
+
+	struct PendingPairs : public btOverlapCallback {
+		static bool removing(const btBroadphaseProxy* proxy) {
+			const btRigidBody* rigidBody = btRigidBody::upcast((const btCollisionObject*)proxy->m_clientObject);
+
+			return rigidBody && static_cast<const Body*>(rigidBody)->removing;
+		}
+
+		bool processOverlap(btBroadphasePair& pair) final {
+			return removing(pair.m_pProxy0) || removing(pair.m_pProxy1);
+		}
+	} pendingPairs;
+
+	// the removed bodies' colliders are gone, so their contact ends are queued here from removedEntity
+	// and bullet's callbacks are muted while their manifolds are cleared, like restoreState
+	auto entityOf = [](const btCollisionObject* object) {
+		const btRigidBody* rigidBody = btRigidBody::upcast(object);
+
+		if (rigidBody && static_cast<const Body*>(rigidBody)->removing)
+			return static_cast<const Body*>(rigidBody)->removedEntity;
+
+		return ((Collider*)object->getUserPointer())->self;
+	};
+
+	{
+		btDispatcher* dispatcher = _dynamicsWorld->getDispatcher();
+
+		std::lock_guard<std::mutex> lock(pendingCollidingLock);
+
+		for (int i = 0; i < dispatcher->getNumManifolds(); i++) {
+			const btPersistentManifold* manifold = dispatcher->getManifoldByIndexInternal(i);
+
+			const btCollisionObject* first = manifold->getBody0();
+			const btCollisionObject* second = manifold->getBody1();
+
+			if (!manifold->getNumContacts() ||
+				(!PendingPairs::removing(first->getBroadphaseHandle()) && !PendingPairs::removing(second->getBroadphaseHandle())))
+				continue;
+
+			// bodies with callbacks carry the custom material flag, whether or not their collider is still around
+			if (!((first->getCollisionFlags() | second->getCollisionFlags()) & btCollisionObject::CF_CUSTOM_MATERIAL_CALLBACK))
+				continue;
+
+			CollidingEvent collidingEvent;
+			collidingEvent.firstEntity = entityOf(first);
+			collidingEvent.secondEntity = entityOf(second);
+			collidingEvent.colliding = false;
+
+			readManifold(manifold, &collidingEvent);
+
+			pendingColliding.push_back(collidingEvent);
+		}
+	}
+
+	gContactStartedCallback = nullptr;
+	gContactEndedCallback = nullptr;
+
+	// one pass over the pairs for the whole batch, instead of one per body
+	_broadphase->getOverlappingPairCache()->processAllOverlappingPairs(&pendingPairs, _dispatcher.get());
+
+	// same for bullet's list of moving bodies, removeRigidBody searches it each time
+	auto& nonStaticBodies = _dynamicsWorld->getNonStaticRigidBodies();
+
+	for (int i = 0; i < nonStaticBodies.size();) {
+		if (static_cast<Body*>(nonStaticBodies[i])->removing) {
+			nonStaticBodies.swap(i, nonStaticBodies.size() - 1);
+			nonStaticBodies.pop_back();
+		}
+		else {
+			i++;
+		}
+	}
+
+	// no pairs are left to find, so the dbvt's per proxy scans get an empty cache
+	btNullPairCache noPairs;
+	btOverlappingPairCache* pairCache = nullptr;
+
+	if (_dbvt) {
+		pairCache = _dbvt->m_paircache;
+		_dbvt->m_paircache = &noPairs;
+	}
+
+	for (Body* body : _pendingRemovals) {
+		_dynamicsWorld->btCollisionWorld::removeCollisionObject(body);
+		_bodies.destroy(body);
+	}
+
+	if (_dbvt)
+		_dbvt->m_paircache = pairCache;
+
+	gContactStartedCallback = contactCallback<true>;
+	gContactEndedCallback = contactCallback<false>;
+
+	_pendingRemovals.clear();
+}
+
+void Physics::beginBatch() {
+	if (_batching)
+		return;
+
+	if (_threaded)
+		_batchLock = std::unique_lock<std::mutex>(_worldMutex);
+
+	_batching = true;
+}
+
+void Physics::endBatch() {
+	if (!_batching)
+		return;
+
+	_batching = false;
+
+	if (!_pendingRemovals.empty())
+		_removePending();
+
+	// parts find their roots whichever order the batch added them in
+	for (Collider* collider : _pendingAttach) {
+		if (!collider->rigidBody)
+			_attach(collider);
+	}
+
+	_pendingAttach.clear();
+
+	if (_batchLock.owns_lock())
+		_batchLock.unlock();
+}
+
+void Physics::_addPart(Collider* root, Collider* part) {
+	Body* body = static_cast<Body*>(root->rigidBody);
+
+	part->compoundRoot = root;
+	part->rigidBody = body;
+	part->layer = root->layer;
+
+	body->parts.push_back(part);
+
+	if (!body->compoundDirty) {
+		body->compoundDirty = true;
+		_dirtyCompounds.push_back(body);
+	}
+}
+
+void Physics::_removePart(Collider* part) {
+	Body* body = static_cast<Body*>(part->compoundRoot->rigidBody);
+
+	auto i = std::find(body->parts.begin(), body->parts.end(), part);
+	*i = body->parts.back();
+	body->parts.pop_back();
+
+	part->compoundRoot = nullptr;
+	part->rigidBody = nullptr;
+
+	if (!body->compoundDirty) {
+		body->compoundDirty = true;
+		_dirtyCompounds.push_back(body);
+	}
+}
+
+void Physics::_rebuildCompounds() {
+	std::vector<btScalar> masses;
+
+	for (Body* body : _dirtyCompounds) {
+		body->compoundDirty = false;
+
+		Collider* root = body->collider;
+		const bool dynamic = !body->isStaticOrKinematicObject();
+
+		glm::vec3 rootPosition;
+		glm::quat rootRotation;
+		glm::vec3 rootScale(1.f);
+
+		if (root->self.has_component<Transform>())
+			_hierarchy->globalDecomposed(root->self, &rootPosition, &rootRotation, &rootScale);
+
+		const glm::quat inverseRootRotation = glm::inverse(rootRotation);
+
+		// every child's mass and centerOfMass, the root's shape first at the collider's origin
+		auto compound = std::make_unique<btCompoundShape>(true, (int)body->parts.size() + 1);
+		compound->addChildShape(btTransform::getIdentity(), root->shape);
+
+		masses.assign(1, root->bodyInfo.mass);
+		btVector3 massOffset = toBt(rootScale * root->bodyInfo.centerOfMass) * root->bodyInfo.mass;
+
+		for (Collider* part : body->parts) {
+			if (dynamic && part->shape->isConcave()) {
+				std::cerr << "System Physics: mesh colliders can't be parts of moving bodies, part ignored" << std::endl;
+				continue;
+			}
+
+			glm::vec3 partPosition = rootPosition;
+			glm::quat partRotation = rootRotation;
+			glm::vec3 partScale = rootScale;
+
+			if (part->self.has_component<Transform>())
+				_hierarchy->globalDecomposed(part->self, &partPosition, &partRotation, &partScale);
+
+			// shapes already carry their global scale, so children are only placed and turned
+			const btTransform childTransform(toBt(inverseRootRotation * partRotation), toBt(inverseRootRotation * (partPosition - rootPosition)));
+
+			compound->addChildShape(childTransform, part->shape);
+
+			masses.push_back(part->bodyInfo.mass);
+			massOffset += childTransform.getBasis() * toBt(partScale * part->bodyInfo.centerOfMass) * part->bodyInfo.mass;
+		}
+
+		btScalar mass = 0.f;
+
+		for (btScalar childMass : masses)
+			mass += childMass;
+
+		// bullet takes the shape's origin as the centre of mass, so moving bodies are shifted to theirs
+		btTransform centerOfMassOffset = btTransform::getIdentity();
+		btVector3 localInertia(0.f, 0.f, 0.f);
+
+		const bool offCentre = !body->parts.empty() || (dynamic && massOffset != btVector3(0.f, 0.f, 0.f));
+
+		if (dynamic && offCentre && mass > 0.f) {
+			compound->calculatePrincipalAxisTransform(masses.data(), centerOfMassOffset, localInertia);
+
+			// the principal axes put it between the child origins, centerOfMass moves it from there
+			centerOfMassOffset.setOrigin(centerOfMassOffset.getOrigin() + massOffset / mass);
+
+			const btTransform inverseOffset = centerOfMassOffset.inverse();
+
+			for (int i = 0; i < compound->getNumChildShapes(); i++)
+				compound->updateChildTransform(i, inverseOffset * compound->getChildTransform(i), false);
+
+			compound->recalculateLocalAabb();
+		}
+		else if (dynamic) {
+			root->shape->calculateLocalInertia(mass, localInertia);
+		}
+
+		if (!offCentre)
+			compound.reset();
+
+		body->setCollisionShape(compound ? compound.get() : root->shape);
+
+		// the collider keeps its place, the body moves to the new centre
+		body->centerOfMassOffset = centerOfMassOffset;
+
+		btRigidBody* rigidBody = body;
+		rigidBody->setWorldTransform(body->currentTransform * centerOfMassOffset);
+		rigidBody->setInterpolationWorldTransform(rigidBody->getWorldTransform());
+
+		if (dynamic) {
+			body->setMassProps(mass, localInertia);
+			body->updateInertiaTensor();
+			body->activate(true);
+		}
+		else {
+			// static roots never wake, so bullet's aabb pass would leave their old bounds
+			_dynamicsWorld->updateSingleAabb(body);
+		}
+
+		// pair algorithms were picked for the old shape
+		_dynamicsWorld->updateSingleAabb(body);
+		_broadphase->getOverlappingPairCache()->cleanProxyFromPairs(body->getBroadphaseHandle(), _dispatcher.get());
+
+		body->compound = std::move(compound);
+	}
+
+	_dirtyCompounds.clear();
+
+	// no body in the world points at these anymore
+	for (const btCollisionShape* shape : _releasedShapes)
+		_shapes.release(shape);
+
+	_releasedShapes.clear();
+}
+
+void Physics::_addTrigger(Collider* collider) {
+	Ghost* ghost = _ghosts.create(collider);
+	collider->ghostObject = ghost;
+
+	const bool isStatic = collider->bodyInfo.type == Collider::StaticTrigger;
+
+	ghost->setCollisionFlags(btCollisionObject::CollisionFlags::CF_NO_CONTACT_RESPONSE | (isStatic ? btCollisionObject::CollisionFlags::CF_STATIC_OBJECT : 0));
+
+	if (!collider->bodyInfo.layer.empty())
+		collider->layer = _layerIndex(collider->bodyInfo.layer);
+	else if (std::find(_layerNames.begin(), _layerNames.end(), "trigger") != _layerNames.end())
+		collider->layer = _layerIndex("trigger");
+	else
+		collider->layer = 0;
+
+	_dynamicsWorld->addCollisionObject(ghost, (int)(1u << collider->layer), _layerMasks[collider->layer]);
+
+	// static ghosts keep the bounds they were added with
+	if (isStatic) {
+		ghost->setActivationState(ISLAND_SLEEPING);
+		return;
+	}
+
+	ghost->setActivationState(DISABLE_DEACTIVATION);
+
+	ghost->movingSlot = (uint32_t)_movingGhosts.size();
+	_movingGhosts.push_back(ghost);
+}
+
+void Physics::_removeTrigger(Collider* collider) {
+	Ghost* ghost = static_cast<Ghost*>(collider->ghostObject);
+
+	if (_threaded)
+		_dropCommands([ghost](const btCollisionObject* object) { return object == ghost; });
+
+	// other triggers record this one leaving
+	_dynamicsWorld->removeCollisionObject(ghost);
+
+	auto pending = std::find(_pendingGhosts.begin(), _pendingGhosts.end(), ghost);
+
+	if (pending != _pendingGhosts.end()) {
+		*pending = _pendingGhosts.back();
+		_pendingGhosts.pop_back();
+	}
+
+	auto published = std::find(_publishedGhosts.begin(), _publishedGhosts.end(), ghost);
+
+	if (published != _publishedGhosts.end()) {
+		*published = _publishedGhosts.back();
+		_publishedGhosts.pop_back();
+	}
+
+	if (!ghost->isStaticObject()) {
+		_movingGhosts[ghost->movingSlot] = _movingGhosts.back();
+		_movingGhosts[ghost->movingSlot]->movingSlot = ghost->movingSlot;
+		_movingGhosts.pop_back();
+	}
+
+	_ghosts.destroy(ghost);
+	collider->ghostObject = nullptr;
+
+	_shapes.release(collider->shape);
+	collider->shape = nullptr;
+}
+
+const std::vector<entityx::Entity>& Physics::triggerEntered(entityx::Entity trigger) const {
+	static const std::vector<entityx::Entity> none;
+
+	if (!trigger.has_component<Collider>() || !trigger.component<const Collider>()->ghostObject)
+		return none;
+
+	return static_cast<const Ghost*>(trigger.component<const Collider>()->ghostObject)->entered;
+}
+
+const std::vector<entityx::Entity>& Physics::triggerExited(entityx::Entity trigger) const {
+	static const std::vector<entityx::Entity> none;
+
+	if (!trigger.has_component<Collider>() || !trigger.component<const Collider>()->ghostObject)
+		return none;
+
+	return static_cast<const Ghost*>(trigger.component<const Collider>()->ghostObject)->exited;
+}
+
+const std::vector<entityx::Entity>& Physics::changedTriggers() const {
+	return _changedTriggers;
+}
+
+void Physics::triggerOverlaps(entityx::Entity trigger, std::vector<entityx::Entity>& overlaps) const {
+	overlaps.clear();
+
+	auto worldLock = _lockWorld();
+
+	if (!trigger.has_component<Collider>() || !trigger.component<const Collider>()->ghostObject)
+		return;
+
+	const btGhostObject* ghost = trigger.component<const Collider>()->ghostObject;
+
+	for (int i = 0; i < ghost->getNumOverlappingObjects(); i++) {
+		const Collider* collider = (Collider*)ghost->getOverlappingObject(i)->getUserPointer();
+
+		// bodies removed inside a batch stay paired until it ends
+		if (collider)
+			overlaps.push_back(collider->self);
+	}
+}
+
+void Physics::setGravity(const glm::vec3 & gravity) {
+	auto worldLock = _lockWorld();
+	_dynamicsWorld->setGravity(toBt(gravity));
+}
+
+void Physics::setLodFocus(entityx::Entity focus) {
+	_lodFocus = focus;
+}
+
+uint8_t Physics::_layerIndex(const std::string& name) const {
+	auto found = std::find(_layerNames.begin(), _layerNames.end(), name);
+
+	if (found == _layerNames.end()) {
+		std::cerr << "System Physics: unknown collision layer " << name << ", using " << _layerNames[0] << std::endl;
+		return 0;
+	}
+
+	return (uint8_t)(found - _layerNames.begin());
+}
+
+void Physics::_refreshFilter(btCollisionObject* object, uint8_t layer) {
+	btBroadphaseProxy* proxy = object->getBroadphaseHandle();
+
+	if (!proxy)
+		return;
+
+	proxy->m_collisionFilterGroup = (int)(1u << layer);
+	proxy->m_collisionFilterMask = _layerMasks[layer];
+
+	// pairs are only filtered when added, so the proxy is recreated to drop rejected pairs and find allowed ones
+	_dynamicsWorld->refreshBroadphaseProxy(object);
+}
+
+void Physics::setLayersInteract(const std::string& first, const std::string& second, bool interact) {
+	const uint8_t firstLayer = _layerIndex(first);
+	const uint8_t secondLayer = _layerIndex(second);
+
+	auto worldLock = _lockWorld();
+
+	if (interact) {
+		_layerMasks[firstLayer] |= (int)(1u << secondLayer);
+		_layerMasks[secondLayer] |= (int)(1u << firstLayer);
+	}
+	else {
+		_layerMasks[firstLayer] &= ~(int)(1u << secondLayer);
+		_layerMasks[secondLayer] &= ~(int)(1u << firstLayer);
+	}
+
+	auto& objects = _dynamicsWorld->getCollisionObjectArray();
+
+	for (int i = 0; i < objects.size(); i++) {
+		const Collider* collider = (Collider*)objects[i]->getUserPointer();
+
+		// removed inside a batch, keeps its emptied filter
+		if (!collider)
+			continue;
+
+		const uint8_t layer = collider->layer;
+
+		if (layer == firstLayer || layer == secondLayer)
+			_refreshFilter(objects[i], layer);
+	}
+}
+
+void Physics::setLayer(entityx::Entity entity, const std::string& layer) {
+	if (!entity.has_component<Collider>())
+		return;
+
+	auto collider = entity.component<Collider>();
+
+	// parts share their root's layer
+	if (collider->compoundRoot)
+		return;
+
+	auto worldLock = _lockWorld();
+
+	collider->layer = _layerIndex(layer);
+
+	if (collider->rigidBody)
+		_refreshFilter(collider->rigidBody, collider->layer);
+	else if (collider->ghostObject)
+		_refreshFilter(collider->ghostObject, collider->layer);
+}
+
+int Physics::layerGroup(const std::string& layer) const {
+	return (int)(1u << _layerIndex(layer));
+}
+
+int Physics::layerMask(const std::string& layer) const {
+	return _layerMasks[_layerIndex(layer)];
+}
+
+void Physics::_runQueries(uint32_t count, const std::function<void(uint32_t)>& query) {
+	if (!_workers || count < _parallelQueryThreshold) {
+		for (uint32_t i = 0; i < count; i++)
+			query(i);
+
+		return;
+	}
+
+	// bullet keeps per thread ray stacks in the broadphase (BT_THREADSAFE), so queries can run side by side
+	const uint32_t chunkSize = 64;
+
+	_workers->run((count + chunkSize - 1) / chunkSize, [&](uint32_t chunk) {
+		const uint32_t end = std::min(count, (chunk + 1) * chunkSize);
+
+		for (uint32_t i = chunk * chunkSize; i < end; i++)
+			query(i);
+	});
+}
+
+void Physics::rayTest(const Ray* rays, uint32_t count, const QueryInfo& queryInfo, QueryHit* hits, uint32_t* hitCounts) {
+	auto worldLock = _lockWorld();
+
+	_runQueries(count, [&](uint32_t i) {
+		btVector3 from(toBt(rays[i].from));
+		btVector3 to(toBt(rays[i].to));
+
+		QueryHit* queryHits = hits + i * queryInfo.maxHits;
+
+		if (queryInfo.mode == Closest) {
+			QueryCallback<btCollisionWorld::ClosestRayResultCallback> result(from, to);
+			result.triggers = queryInfo.triggers;
+			result.m_collisionFilterGroup = queryInfo.group;
+			result.m_collisionFilterMask = queryInfo.mask;
+			result.m_flags |= btTriangleRaycastCallback::kF_KeepUnflippedNormal;
+			result.m_flags |= btTriangleRaycastCallback::kF_UseSubSimplexConvexCastRaytest;
+
+			_dynamicsWorld->rayTest(from, to, result);
+
+			hitCounts[i] = 0;
+
+			if (result.hasHit() && queryInfo.maxHits > 0) {
+				queryHits[0].entity = ((Collider*)result.m_collisionObject->getUserPointer())->self;
+				queryHits[0].globalPosition = fromBt(result.m_hitPointWorld);
+				queryHits[0].globalNormal = fromBt(result.m_hitNormalWorld);
+				queryHits[0].fraction = result.m_closestHitFraction;
+				hitCounts[i] = 1;
+			}
+
+			return;
+		}
+
+		QueryCallback<btCollisionWorld::AllHitsRayResultCallback> result(from, to);
+		result.triggers = queryInfo.triggers;
+		result.m_collisionFilterGroup = queryInfo.group;
+		result.m_collisionFilterMask = queryInfo.mask;
+		result.m_flags |= btTriangleRaycastCallback::kF_KeepUnflippedNormal;
+		result.m_flags |= btTriangleRaycastCallback::kF_UseSubSimplexConvexCastRaytest;
+
+		_dynamicsWorld->rayTest(from, to, result);
+
+		// hits arrive in broadphase order, keep the nearest
+		thread_local std::vector<QueryHit> found;
+		found.resize(result.m_collisionObjects.size());
+
+		for (int j = 0; j < result.m_collisionObjects.size(); j++) {
+			found[j].entity = ((Collider*)result.m_collisionObjects[j]->getUserPointer())->self;
+			found[j].globalPosition = fromBt(result.m_hitPointWorld[j]);
+			found[j].globalNormal = fromBt(result.m_hitNormalWorld[j]);
+			found[j].fraction = result.m_hitFractions[j];
+		}
+
+		hitCounts[i] = nearestHits(found, queryInfo.maxHits, queryHits);
+	});
+}
+
+void Physics::sweepTest(const Collider::ShapeInfo& shapeInfo, const Sweep* sweeps, uint32_t count, const QueryInfo& queryInfo, QueryHit* hits, uint32_t* hitCounts) {
+	auto worldLock = _lockWorld();
+
+	btCollisionShape* shape = _shapes.acquire(shapeInfo, glm::vec3(1.f));
+
+	// mesh files that fail to load give no shape
+	if (!shape) {
+		std::fill(hitCounts, hitCounts + count, 0);
+		return;
+	}
+
+	if (!shape->isConvex()) {
+		std::cerr << "System Physics: sweep shape has to be convex" << std::endl;
+
+		std::fill(hitCounts, hitCounts + count, 0);
+		_shapes.release(shape);
+		return;
+	}
+
+	const btConvexShape* convexShape = (btConvexShape*)shape;
+
+	_runQueries(count, [&](uint32_t i) {
+		btTransform from(toBt(sweeps[i].rotation), toBt(sweeps[i].from));
+		btTransform to(toBt(sweeps[i].rotation), toBt(sweeps[i].to));
+
+		QueryHit* queryHits = hits + i * queryInfo.maxHits;
+
+		if (queryInfo.mode == Closest) {
+			QueryCallback<btCollisionWorld::ClosestConvexResultCallback> result(from.getOrigin(), to.getOrigin());
+			result.triggers = queryInfo.triggers;
+			result.m_collisionFilterGroup = queryInfo.group;
+			result.m_collisionFilterMask = queryInfo.mask;
+
+			_dynamicsWorld->convexSweepTest(convexShape, from, to, result);
+
+			hitCounts[i] = 0;
+
+			if (result.hasHit() && queryInfo.maxHits > 0) {
+				queryHits[0].entity = ((Collider*)result.m_hitCollisionObject->getUserPointer())->self;
+				queryHits[0].globalPosition = fromBt(result.m_hitPointWorld);
+				queryHits[0].globalNormal = fromBt(result.m_hitNormalWorld);
+				queryHits[0].fraction = result.m_closestHitFraction;
+				hitCounts[i] = 1;
+			}
+
+			return;
+		}
+
+		thread_local QueryCallback<AllConvexResultCallback> result;
+		result.found.clear();
+		result.triggers = queryInfo.triggers;
+		result.m_closestHitFraction = 1.f;
+		result.m_collisionFilterGroup = queryInfo.group;
+		result.m_collisionFilterMask = queryInfo.mask;
+
+		_dynamicsWorld->convexSweepTest(convexShape, from, to, result);
+
+		hitCounts[i] = nearestHits(result.found, queryInfo.maxHits, queryHits);
+	});
+
+	_shapes.release(shape);
+}
+
+void Physics::_gatherCandidates(const btVector3& aabbMin, const btVector3& aabbMax, int mask) {
+	struct Collector : public btBroadphaseAabbCallback {
+		std::vector<const btBroadphaseProxy*>* candidates;
+		int mask;
+
+		bool process(const btBroadphaseProxy* proxy) final {
+			if (proxy->m_collisionFilterGroup & mask)
+				candidates->push_back(proxy);
+
+			return true;
+		}
+	} collector;
+
+	collector.candidates = &_overlapCandidates;
+	collector.mask = mask;
+
+	_overlapCandidates.clear();
+	_broadphase->aabbTest(aabbMin, aabbMax, collector);
+}
+
+void Physics::_exactOverlaps(btCollisionShape* shape, const btTransform& transform, std::vector<entityx::Entity>& overlaps) {
+	struct OverlapCallback : public btCollisionWorld::ContactResultCallback {
+		bool overlapping = false;
+
+		btScalar addSingleResult(btManifoldPoint& point, const btCollisionObjectWrapper*, int, int, const btCollisionObjectWrapper*, int, int) final {
+			if (point.getDistance() <= 0)
+				overlapping = true;
+
+			return 0;
+		}
+	};
+
+	btCollisionObject queryObject;
+	queryObject.setCollisionShape(shape);
+	queryObject.setWorldTransform(transform);
+
+	for (const btBroadphaseProxy* proxy : _overlapCandidates) {
+		btCollisionObject* object = (btCollisionObject*)proxy->m_clientObject;
+
+		OverlapCallback callback;
+		_dynamicsWorld->contactPairTest(&queryObject, object, callback);
+
+		if (callback.overlapping)
+			overlaps.push_back(((Collider*)object->getUserPointer())->self);
+	}
+}
+
+void Physics::overlapSphere(const glm::vec3& center, float radius, std::vector<entityx::Entity>& overlaps, OverlapMode mode, int mask) {
+	overlaps.clear();
+
+	auto worldLock = _lockWorld();
+
+	const btVector3 btCenter(toBt(center));
+	_gatherCandidates(btCenter - btVector3(radius, radius, radius), btCenter + btVector3(radius, radius, radius), mask);
+
+	if (mode == Exact) {
+		btSphereShape sphere(radius);
+		_exactOverlaps(&sphere, btTransform(btQuaternion::getIdentity(), btCenter), overlaps);
+		return;
+	}
+
+	// tree hits overlap the sphere's box, keep bounds the sphere itself reaches
+	for (const btBroadphaseProxy* proxy : _overlapCandidates) {
+		btVector3 closest = btCenter;
+		closest.setMax(proxy->m_aabbMin);
+		closest.setMin(proxy->m_aabbMax);
+
+		if (closest.distance2(btCenter) <= radius * radius)
+			overlaps.push_back(((Collider*)((btCollisionObject*)proxy->m_clientObject)->getUserPointer())->self);
+	}
+}
+
+void Physics::overlapBox(const glm::vec3& center, const glm::vec3& halfExtents, const glm::quat& rotation, std::vector<entityx::Entity>& overlaps, OverlapMode mode, int mask) {
+	overlaps.clear();
+
+	auto worldLock = _lockWorld();
+
+	btTransform transform(toBt(rotation), toBt(center));
+	btBoxShape box(toBt(halfExtents));
+
+	btVector3 aabbMin, aabbMax;
+	box.getAabb(transform, aabbMin, aabbMax);
+
+	_gatherCandidates(aabbMin, aabbMax, mask);
+
+	if (mode == Exact) {
+		_exactOverlaps(&box, transform, overlaps);
+		return;
+	}
+
+	for (const btBroadphaseProxy* proxy : _overlapCandidates)
+		overlaps.push_back(((Collider*)((btCollisionObject*)proxy->m_clientObject)->getUserPointer())->self);
+}
+
+void Physics::overlapFrustum(const glm::mat4& viewProjection, std::vector<entityx::Entity>& overlaps, int mask) {
+	overlaps.clear();
+
+	auto worldLock = _lockWorld();
+
+	struct Collector : public btDbvt::ICollide {
+		std::vector<entityx::Entity>* overlaps;
+		int mask;
+
+		void Process(const btDbvtNode* leaf) {
+			const btBroadphaseProxy* proxy = (const btBroadphaseProxy*)leaf->data;
+
+			if (proxy->m_collisionFilterGroup & mask)
+				overlaps->push_back(((Collider*)((btCollisionObject*)proxy->m_clientObject)->getUserPointer())->self);
+		}
+	} collector;
+
+	collector.overlaps = &overlaps;
+	collector.mask = mask;
+
+	// frustum planes from the rows of the view projection, pointing inwards
+	btVector3 normals[6];
+	btScalar offsets[6];
+
+	for (int i = 0; i < 6; i++) {
+		const int row = i / 2;
+		const float sign = (i % 2 == 0) ? 1.f : -1.f;
+
+		glm::vec4 plane(
+			viewProjection[0][3] + sign * viewProjection[0][row],
+			viewProjection[1][3] + sign * viewProjection[1][row],
+			viewProjection[2][3] + sign * viewProjection[2][row],
+			viewProjection[3][3] + sign * viewProjection[3][row]);
+
+		plane /= glm::length(glm::vec3(plane));
+
+		normals[i] = btVector3(plane.x, plane.y, plane.z);
+		offsets[i] = plane.w;
+	}
+
+	// dynamic and static trees
+	if (_dbvt) {
+		btDbvt::collideKDOP(_dbvt->m_sets[0].m_root, normals, offsets, 6, collector);
+		btDbvt::collideKDOP(_dbvt->m_sets[1].m_root, normals, offsets, 6, collector);
+		return;
+	}
+
+	// other broadphases have no tree to cull, test every proxy's bounds against the planes
+	const btVector3 large(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT);
+	_gatherCandidates(-large, large, mask);
+
+	for (const btBroadphaseProxy* proxy : _overlapCandidates) {
+		bool inside = true;
+
+		for (int i = 0; i < 6 && inside; i++) {
+			// corner furthest along the plane normal
+			const btVector3 corner(
+				normals[i].x() >= 0 ? proxy->m_aabbMax.x() : proxy->m_aabbMin.x(),
+				normals[i].y() >= 0 ? proxy->m_aabbMax.y() : proxy->m_aabbMin.y(),
+				normals[i].z() >= 0 ? proxy->m_aabbMax.z() : proxy->m_aabbMin.z());
+
+			inside = normals[i].dot(corner) + offsets[i] >= 0;
+		}
+
+		if (inside)
+			overlaps.push_back(((Collider*)((btCollisionObject*)proxy->m_clientObject)->getUserPointer())->self);
+	}
+}
+
+void Physics::saveState(std::vector<uint8_t>& buffer) const {
+	buffer.clear();
+
+	auto worldLock = _lockWorld();
+
+	const auto& bodies = _dynamicsWorld->getNonStaticRigidBodies();
+	btDispatcher* dispatcher = _dynamicsWorld->getDispatcher();
+
+	// bodies removed inside a batch are left out, they leave the world before the next step
+	StateHeader header;
+	header.accumulator = _accumulator;
+	header.objectCount = liveObjects(_dynamicsWorld->getCollisionObjectArray());
+	header.bodyCount = liveObjects(bodies);
+	header.manifoldCount = 0;
+
+	for (int i = 0; i < dispatcher->getNumManifolds(); i++) {
+		const btPersistentManifold* manifold = dispatcher->getManifoldByIndexInternal(i);
+
+		if (manifold->getBody0()->getUserPointer() && manifold->getBody1()->getUserPointer())
+			header.manifoldCount++;
+	}
+
+	writeState(buffer, header);
+
+	for (int i = 0; i < bodies.size(); i++) {
+		const btRigidBody* rigidBody = bodies[i];
+		const Body* body = static_cast<const Body*>(rigidBody);
+
+		if (body->removing)
+			continue;
+
+		BodyState state;
+		state.id = objectId(body);
+		state.worldTransform = rigidBody->getWorldTransform();
+		state.interpolationWorldTransform = rigidBody->getInterpolationWorldTransform();
+		state.previousTransform = body->previousTransform;
+		state.currentTransform = body->currentTransform;
+		state.linearVelocity = rigidBody->getLinearVelocity();
+		state.angularVelocity = rigidBody->getAngularVelocity();
+		state.interpolationLinearVelocity = rigidBody->getInterpolationLinearVelocity();
+		state.interpolationAngularVelocity = rigidBody->getInterpolationAngularVelocity();
+		state.deactivationTime = rigidBody->getDeactivationTime();
+		state.activationState = rigidBody->getActivationState();
+		state.settled = body->settled;
+
+		writeState(buffer, state);
+	}
+
+	// contact points carry the applied impulses the solver warm starts from
+	for (int i = 0; i < dispatcher->getNumManifolds(); i++) {
+		const btPersistentManifold* manifold = dispatcher->getManifoldByIndexInternal(i);
+
+		if (!manifold->getBody0()->getUserPointer() || !manifold->getBody1()->getUserPointer())
+			continue;
+
+		ManifoldState state;
+		state.firstObject = (uint32_t)manifold->getBody0()->getWorldArrayIndex();
+		state.secondObject = (uint32_t)manifold->getBody1()->getWorldArrayIndex();
+		state.firstId = objectId(manifold->getBody0());
+		state.secondId = objectId(manifold->getBody1());
+		state.pointCount = (uint32_t)manifold->getNumContacts();
+
+		writeState(buffer, state);
+
+		for (uint32_t j = 0; j < state.pointCount; j++)
+			writeState(buffer, manifold->getContactPoint(j));
+	}
+}
+
+bool Physics::restoreState(const std::vector<uint8_t>& buffer) {
+	auto worldLock = _lockWorld();
+
+	const auto& bodies = _dynamicsWorld->getNonStaticRigidBodies();
+	const auto& objects = _dynamicsWorld->getCollisionObjectArray();
+
+	size_t offset = 0;
+
+	StateHeader header;
+	StateHeader expected;
+
+	if (!readState(buffer, offset, &header) ||
+		std::memcmp(header.magic, expected.magic, sizeof(header.magic)) ||
+		header.objectCount != liveObjects(objects) ||
+		header.bodyCount != liveObjects(bodies) ||
+		buffer.size() < offset + header.bodyCount * sizeof(BodyState))
+		return false;
+
+	// check every body first, nothing is written unless the whole snapshot matches
+	size_t bodyOffset = offset;
+
+	for (int i = 0; i < bodies.size(); i++) {
+		if (static_cast<const Body*>(bodies[i])->removing)
+			continue;
+
+		// the id leads each state
+		uint64_t id;
+		std::memcpy(&id, buffer.data() + bodyOffset, sizeof(id));
+		bodyOffset += sizeof(BodyState);
+
+		if (id != objectId(bodies[i]))
+			return false;
+	}
+
+	// and every manifold, a truncated or mismatched contact section fails before anything is written
+	size_t manifoldOffset = offset + header.bodyCount * sizeof(BodyState);
+
+	for (uint32_t i = 0; i < header.manifoldCount; i++) {
+		ManifoldState state;
+
+		if (!readState(buffer, manifoldOffset, &state) ||
+			state.pointCount > MANIFOLD_CACHE_SIZE ||
+			state.firstObject >= (uint32_t)objects.size() ||
+			state.secondObject >= (uint32_t)objects.size() ||
+			state.firstId != objectId(objects[state.firstObject]) ||
+			state.secondId != objectId(objects[state.secondObject]))
+			return false;
+
+		manifoldOffset += state.pointCount * sizeof(btManifoldPoint);
+
+		if (manifoldOffset > buffer.size())
+			return false;
+	}
+
+	for (int i = 0; i < bodies.size(); i++) {
+		btRigidBody* rigidBody = bodies[i];
+		Body* body = static_cast<Body*>(rigidBody);
+
+		if (body->removing)
+			continue;
+
+		BodyState state;
+		readState(buffer, offset, &state);
+
+		rigidBody->setWorldTransform(state.worldTransform);
+		rigidBody->setInterpolationWorldTransform(state.interpolationWorldTransform);
+		rigidBody->setLinearVelocity(state.linearVelocity);
+		rigidBody->setAngularVelocity(state.angularVelocity);
+		rigidBody->setInterpolationLinearVelocity(state.interpolationLinearVelocity);
+		rigidBody->setInterpolationAngularVelocity(state.interpolationAngularVelocity);
+		rigidBody->setDeactivationTime(state.deactivationTime);
+		rigidBody->forceActivationState(state.activationState);
+		rigidBody->clearForces();
+
+		body->previousTransform = state.previousTransform;
+		body->currentTransform = state.currentTransform;
+		body->settled = state.settled != 0;
+
+		// sleeping bodies are skipped by bullet's own aabb pass
+		_dynamicsWorld->updateSingleAabb(rigidBody);
+	}
+
+	_accumulator = header.accumulator;
+
+	// restored pairs start and end silently, the stream and triggers only report simulated changes
+	gContactStartedCallback = nullptr;
+	gContactEndedCallback = nullptr;
+	_ghostPairs.recording = false;
+
+	// brings the pair cache and its manifolds in line with the restored transforms
+	_dynamicsWorld->performDiscreteCollisionDetection();
+
+	btDispatcher* dispatcher = _dynamicsWorld->getDispatcher();
+
+	_restoredManifolds.clear();
+
+	for (int i = 0; i < dispatcher->getNumManifolds(); i++) {
+		btPersistentManifold* manifold = dispatcher->getManifoldByIndexInternal(i);
+		manifold->clearManifold();
+
+		_restoredManifolds[((uint64_t)manifold->getBody0()->getWorldArrayIndex() << 32) | (uint32_t)manifold->getBody1()->getWorldArrayIndex()] = manifold;
+	}
+
+	for (uint32_t i = 0; i < header.manifoldCount; i++) {
+		// sizes were checked above
+		ManifoldState state;
+		readState(buffer, offset, &state);
+
+		auto found = _restoredManifolds.find(((uint64_t)state.firstObject << 32) | state.secondObject);
+
+		for (uint32_t j = 0; j < state.pointCount; j++) {
+			btManifoldPoint point;
+			readState(buffer, offset, &point);
+
+			// pairs that came back flipped or not at all are left to the next narrowphase
+			if (found == _restoredManifolds.end())
+				continue;
+
+			point.m_userPersistentData = nullptr;
+			found->second->addManifoldPoint(point);
+		}
+	}
+
+	gContactStartedCallback = contactCallback<true>;
+	gContactEndedCallback = contactCallback<false>;
+	_ghostPairs.recording = true;
+
+	for (Body* body : _movedBodies)
+		body->moved = false;
+
+	_movedBodies.clear();
+
+	// steps written before the rollback would be shown over it
+	if (_threaded)
+		_dropOutputs([](const Body*) { return true; });
+
+	// written back now, so the rollback shows before the next update
+	for (int i = 0; i < bodies.size(); i++) {
+		Body* body = static_cast<Body*>(bodies[i]);
+
+		if (body->removing)
+			continue;
+
+		if (body->isKinematicObject()) {
+			body->interpolate(1.f);
+
+			if (body->transform)
+				body->syncedVersion = body->transform->version();
+
+			continue;
+		}
+
+		body->interpolate(_accumulator / _fixedTimestep);
+
+		if (!body->settled)
+			_listMoved(body);
+	}
+
+	return true;
+}
+
+const BulletDebug & Physics::bulletDebug() const{
+	return _debugger;
+}
+
+const ContactStream& Physics::contactStream() const {
+	return _contactStream;
 }
@@ -3,42 +3,366 @@
 #include "component\Collider.hpp"
 
 #include "other\BulletDebug.hpp"
+#include "other\ShapeCache.hpp"
+#include "other\AlignedPool.hpp"
+#include "other\ContactStream.hpp"
+#include "other\Broadphase.hpp"
 
 #include <entityx\System.h>
 
 #include <btBulletDynamicsCommon.h>
+#include <BulletCollision\CollisionDispatch\btGhostObject.h>
+#include <BulletDynamics\ConstraintSolver\btSequentialImpulseConstraintSolverMt.h>
+#include <LinearMath\btThreads.h>
+
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+class Hierarchy;
+class WorkerPool;
 
 class Physics : public entityx::System<Physics>, public entityx::Receiver<Physics> {
+	std::unique_ptr<btITaskScheduler> _taskScheduler; // only set for multithreaded worlds
+
 	btDefaultCollisionConfiguration _collisionConfiguration;
-	btCollisionDispatcher _dispatcher;
-	btDbvtBroadphase _overlappingPairCache;
-	btSequentialImpulseConstraintSolver _solver;
-	btDiscreteDynamicsWorld _dynamicsWorld;
+	std::unique_ptr<btBroadphaseInterface> _broadphase;
+	btDbvtBroadphase* _dbvt = nullptr; // same as _broadphase when it's a dbvt, frustum queries walk its trees
+
+	ShapeCache _shapes;
+
+	// rigid body and its motion state in one pooled slot, the state base is constructed first so the body can read it
+	struct Body : public ColliderMotionState, public btRigidBody {
+		// colliders below the root's Transform, merged with its shape into compound
+		std::vector<Collider*> parts;
+		std::unique_ptr<btCompoundShape> compound;
+		bool compoundDirty = false; // parts changed, rebuilt before the next step
+
+		// removed inside a batch, left in the world until endBatch with the collider's entity kept for trigger exits
+		bool removing = false;
+		entityx::Entity removedEntity;
+
+		// listed in the step output being written when outputGeneration matches Physics', at outputSlot
+		uint32_t outputGeneration = 0;
+		uint32_t outputSlot = 0;
+
+		Body(Collider* collider, const btRigidBody::btRigidBodyConstructionInfo& info);
+
+		void setWorldTransform(const btTransform& worldTransform) final;
+	};
+
+	AlignedPool<Body> _bodies;
+
+	// trigger volume, overlaps come straight from the ghost's pair cache
+	struct Ghost : public btPairCachingGhostObject {
+		Collider* collider;
+		Transform* transform = nullptr; // cached like ColliderMotionState's
+		uint32_t syncedVersion = 0;
+		uint32_t movingSlot = 0; // position in _movingGhosts
+
+		// net changes since the last update, recorded as pairs are added and removed
+		std::vector<entityx::Entity> entering;
+		std::vector<entityx::Entity> exiting;
+		bool pending = false;
+
+		// changes published by the last update
+		std::vector<entityx::Entity> entered;
+		std::vector<entityx::Entity> exited;
+
+		Ghost(Collider* collider);
+	};
+
+	// keeps ghost pair caches in step with the broadphase and records enters and exits
+	struct GhostPairCallback : public btGhostPairCallback {
+		std::vector<Ghost*>* pendingGhosts;
+		bool recording = true;
+
+		void record(btBroadphaseProxy* ghostProxy, btBroadphaseProxy* otherProxy, bool entering);
+
+		btBroadphasePair* addOverlappingPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1) final;
+		void* removeOverlappingPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1, btDispatcher* dispatcher) final;
+	};
+
+	AlignedPool<Ghost> _ghosts;
+	GhostPairCallback _ghostPairs;
+
+	// layer masks on top of bullet's default rule, two static or kinematic objects never pair
+	struct LayerFilterCallback : public btOverlapFilterCallback {
+		bool needBroadphaseCollision(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1) const final;
+	};
+
+	LayerFilterCallback _layerFilter;
+
+	std::vector<Ghost*> _movingGhosts; // pushed from their Transform like kinematic bodies
+	std::vector<Ghost*> _pendingGhosts;
+	std::vector<Ghost*> _publishedGhosts;
+	std::vector<entityx::Entity> _changedTriggers;
+
+	std::vector<Body*> _kinematicBodies; // pushed from their Transform before stepping, when its version changed
+	std::vector<Body*> _movedBodies; // awake after the last fixed step, or settled during it, pulled back to their Transform, kept between steps
+	std::vector<Body*> _dirtyCompounds;
+	std::vector<const btCollisionShape*> _releasedShapes; // removed colliders' shapes, released by the next compound rebuild
+
+	// between beginBatch and endBatch
+	bool _batching = false;
+	std::vector<Collider*> _pendingAttach;
+	std::vector<Body*> _pendingRemovals;
+
+	// sequential or multithreaded variants, picked by ConstructorInfo::threadCount
+	std::unique_ptr<btCollisionDispatcher> _dispatcher;
+	std::unique_ptr<btConstraintSolverPoolMt> _solverPool;
+	std::unique_ptr<btConstraintSolver> _solver;
+	std::unique_ptr<btDiscreteDynamicsWorld> _dynamicsWorld;
 
 	BulletDebug _debugger;
 	bool _debugLines;
 
 	glm::vec3 _defaultGravity;
-	uint32_t _stepsPerUpdate;
+
+	const btScalar _fixedTimestep;
+	const uint32_t _maxSubSteps;
+	btScalar _accumulator = 0; // time since the last fixed step, for interpolating between fixed steps, saved with the state
+
+	const Hierarchy* _hierarchy;
+
+	WorkerPool* _workers;
+	const uint32_t _parallelQueryThreshold;
+
+	ContactStream _contactStream;
+
+	// manifold contact and which of its entities list it
+	struct ListedContact {
+		ContactEvent event;
+		bool firstListed;
+		bool secondListed;
+	};
+
+	std::vector<ListedContact> _listedContacts; // of the last update, or the last sync with steps when threaded
+
+	// threaded only, written by the physics thread after each step and handed to the main thread at the next sync
+	struct StepOutput {
+		struct Moved {
+			Body* body;
+			btTransform previousTransform;
+			btTransform currentTransform;
+			btVector3 linearVelocity;
+			btVector3 angularVelocity;
+		};
+
+		std::vector<Moved> moved; // latest state of each body that moved since the last sync
+		std::vector<ListedContact> contacts; // after the last step
+		uint32_t steps = 0;
+	};
+
+	struct Command {
+		const btCollisionObject* object; // dropped if it leaves the world before running, null for world commands
+		std::function<void()> apply;
+	};
+
+	const bool _threaded;
+	std::thread _thread;
+	std::atomic<bool> _running{ false };
+
+	// held by the physics thread while stepping, and by the main thread to change or query the world
+	mutable std::mutex _worldMutex;
+	std::unique_lock<std::mutex> _batchLock; // held from beginBatch to endBatch
+
+	std::mutex _commandMutex;
+	std::vector<Command> _commands;
+	std::vector<Command> _runningCommands; // physics thread only
+
+	// the back output is written under _outputMutex, the front one belongs to the main thread until the next sync
+	std::mutex _outputMutex;
+	StepOutput _outputs[2];
+	uint32_t _frontOutput = 0;
+	uint32_t _outputGeneration = 1;
+	std::chrono::steady_clock::time_point _lastStepTime;
+
+	std::vector<ListedContact> _stepContacts; // physics thread only, gathered before taking the output lock
+
+	// main thread only, interpolated every sync until a sync with steps replaces them
+	std::vector<StepOutput::Moved> _syncedMoved;
+	std::chrono::steady_clock::time_point _syncedStepTime;
+
+	std::vector<const btBroadphaseProxy*> _overlapCandidates; // reused between overlap queries
+
+	std::unordered_map<uint64_t, btPersistentManifold*> _restoredManifolds; // live manifolds by world index pair, reused between restores
+
+	entityx::Entity _lodFocus;
+
+	static void _internalTick(btDynamicsWorld* world, btScalar timeStep);
+
+	void _pushKinematic();
+	void _pullMoved(btScalar alpha);
+	void _listMoved(Body* body);
+	void _removeMoved(Body* body);
+	Collider* _compoundRoot(entityx::Entity entity) const;
+	void _attach(Collider* collider);
+	void _addBody(Collider* collider);
+	void _removeBody(Body* body);
+	void _addPart(Collider* root, Collider* part);
+	void _removePart(Collider* part);
+	void _rebuildCompounds();
+	void _removePending();
+	void _addTrigger(Collider* collider);
+	void _removeTrigger(Collider* collider);
+	void _clearTriggers();
+	void _publishTriggers();
+	void _gatherContacts(std::vector<ListedContact>& contacts) const;
+	void _buildContactStream(const std::vector<ListedContact>& contacts);
+	void _updateLod();
+	void _updateLod(const btVector3& focus);
+	std::unique_lock<std::mutex> _lockWorld() const;
+	void _threadLoop();
+	void _runCommands();
+	void _writeOutput();
+	void _sync(entityx::EventManager& events);
+	void _dropCommands(const std::function<bool(const btCollisionObject*)>& dropped);
+	void _dropOutputs(const std::function<bool(const Body*)>& dropped);
+	void _runQueries(uint32_t count, const std::function<void(uint32_t)>& query);
+	void _gatherCandidates(const btVector3& aabbMin, const btVector3& aabbMax, int mask);
+	void _exactOverlaps(btCollisionShape* shape, const btTransform& transform, std::vector<entityx::Entity>& overlaps);
 
 public:
+	struct LodTier {
+		float distance = 0.f; // from the lod focus, bodies use the furthest tier they are past
+		float linearSleepingThreshold = 32.f;
+		float angularSleepingThreshold = 32.f;
+		bool frozen = false; // bodies entering are put to sleep, awake bodies touching them still wake them
+	};
+
+	struct CollisionLayer {
+		std::string name;
+		std::vector<std::string> ignores; // never paired with these, listing it on either layer is enough
+	};
+
 	struct ConstructorInfo {
+		std::string path = ""; // mesh colliders load relative to this
 		glm::vec3 defaultGravity = { 0.f, 0.f, -1000.f };
-		uint32_t stepsPerUpdate = 1;
+		float fixedTimestep = 1.f / 60.f;
+		uint32_t maxSubSteps = 4; // fixed steps per update before time is dropped, stops slow frames spiralling
+		uint32_t threadCount = 1; // above 1 uses bullet's multithreaded world, needs bullet built with BT_THREADSAFE, not with threaded
+		bool threaded = false; // steps on a thread of its own at the fixed timestep, update becomes a sync point
+		BroadphaseInfo broadphase;
 		bool debugLines = false;
+		const Hierarchy* hierarchy = nullptr;
+		WorkerPool* workers = nullptr; // spreads large query batches, optional, size it to leave threadCount cores to bullet
+		uint32_t parallelQueryThreshold = 256;
+		std::vector<LodTier> lodTiers = { LodTier() }; // sorted by distance, the first applies to new bodies
+		std::vector<CollisionLayer> layers = { { "default" } }; // up to 32, layer i is filter group bit i, unknown names use the first
+	};
+
+private:
+	const std::vector<LodTier> _lodTiers;
+
+	std::vector<std::string> _layerNames;
+	std::vector<int> _layerMasks; // groups each layer pairs with, always symmetric
+
+	uint8_t _layerIndex(const std::string& name) const;
+	void _refreshFilter(btCollisionObject* object, uint8_t layer);
+
+public:
+
+	enum QueryMode {
+		Closest,
+		AllHits
+	};
+
+	struct Ray {
+		glm::vec3 from;
+		glm::vec3 to;
+	};
+
+	struct Sweep {
+		glm::vec3 from;
+		glm::vec3 to;
+		glm::quat rotation;
+	};
+
+	struct QueryInfo {
+		QueryMode mode = Closest;
+		uint32_t maxHits = 1; // hit slots per query, all hits keeps the nearest
+		int group = btBroadphaseProxy::DefaultFilter; // the first collision layer, layerGroup and layerMask give others
+		int mask = btBroadphaseProxy::AllFilter;
+		bool triggers = false; // trigger volumes are passed through unless set, whatever their layer
+	};
+
+	enum OverlapMode {
+		Bounds, // collider bounds against the query volume, cheap and conservative
+		Exact // collider shapes against the query shape
+	};
+
+	struct QueryHit {
+		entityx::Entity entity;
+		glm::vec3 globalPosition;
+		glm::vec3 globalNormal;
+		float fraction = 1.f;
 	};
 
 	Physics(const ConstructorInfo& constructorInfo = ConstructorInfo());
+	~Physics();
 
 	void configure(entityx::EventManager &events) final;
 	void update(entityx::EntityManager &entities, entityx::EventManager &events, double dt) final;
 
 	void receive(const entityx::ComponentAddedEvent<Collider>& colliderAddedEvent);
 	void receive(const entityx::ComponentRemovedEvent<Collider>& colliderRemovedEvent);
+	void receive(const entityx::ComponentRemovedEvent<Transform>& transformRemovedEvent);
+
+	// runs apply straight away, or on the physics thread before its next step when threaded
+	void command(const btCollisionObject* object, const std::function<void()>& apply);
+	// stepping on its own thread, world queries and adding or removing colliders then wait for the step in flight
+	bool threaded() const;
 
 	void setGravity(const glm::vec3& gravity);
+	// bodies pick their lod tier by distance from this entity
+	void setLodFocus(entityx::Entity focus);
+
+	// changes the interaction matrix, bodies on either layer are re-paired straight away
+	void setLayersInteract(const std::string& first, const std::string& second, bool interact);
+	// moves a collider's body to another layer
+	void setLayer(entityx::Entity entity, const std::string& layer);
+
+	// group bit and interaction mask of a layer, for filtering queries like a body on that layer
+	int layerGroup(const std::string& layer) const;
+	int layerMask(const std::string& layer) const;
+
+	// hits needs count * maxHits slots, query i writes hitCounts[i] hits sorted by fraction from hits[i * maxHits]
+	void rayTest(const Ray* rays, uint32_t count, const QueryInfo& queryInfo, QueryHit* hits, uint32_t* hitCounts);
+	// same layout as rayTest, sweeps an unscaled convex shape along each sweep
+	void sweepTest(const Collider::ShapeInfo& shapeInfo, const Sweep* sweeps, uint32_t count, const QueryInfo& queryInfo, QueryHit* hits, uint32_t* hitCounts);
+
+	// overlap queries walk the broadphase trees, overlaps is cleared and filled with collider entities
+	void overlapSphere(const glm::vec3& center, float radius, std::vector<entityx::Entity>& overlaps, OverlapMode mode = Bounds, int mask = btBroadphaseProxy::AllFilter);
+	void overlapBox(const glm::vec3& center, const glm::vec3& halfExtents, const glm::quat& rotation, std::vector<entityx::Entity>& overlaps, OverlapMode mode = Bounds, int mask = btBroadphaseProxy::AllFilter);
+	// colliders with bounds at least partly inside the view projection's frustum
+	void overlapFrustum(const glm::mat4& viewProjection, std::vector<entityx::Entity>& overlaps, int mask = btBroadphaseProxy::AllFilter);
+
+	// bodies whose bounds started and stopped overlapping a trigger over the last update, empty for other entities
+	// exited bodies may have been destroyed since
+	const std::vector<entityx::Entity>& triggerEntered(entityx::Entity trigger) const;
+	const std::vector<entityx::Entity>& triggerExited(entityx::Entity trigger) const;
+	// triggers with entries in either list
+	const std::vector<entityx::Entity>& changedTriggers() const;
+	// bodies whose bounds overlap a trigger now, overlaps is cleared and filled
+	void triggerOverlaps(entityx::Entity trigger, std::vector<entityx::Entity>& overlaps) const;
+
+	// colliders added until endBatch get their bodies together once the batch's hierarchy is in place
+	// removed ones leave the world in one pass, world queries shouldn't be made in between
+	// when threaded the world is held for the whole batch
+	void beginBatch();
+	// also ended by the next update
+	void endBatch();
 
-	void rayTest(const glm::vec3& from, const glm::vec3& to, std::vector<entityx::Entity>& hits);
+	// dynamics state of every body and the contact cache, reuse the buffer to avoid reallocating each frame
+	void saveState(std::vector<uint8_t>& buffer) const;
+	// needs the same bodies as when saved, returns false and leaves the world untouched otherwise
+	bool restoreState(const std::vector<uint8_t>& buffer);
 
 	const BulletDebug& bulletDebug() const;
+	const ContactStream& contactStream() const;
 };
\ No newline at end of file
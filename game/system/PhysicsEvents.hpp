@@ -4,6 +4,8 @@
 
 #include <glm\vec3.hpp>
 
+class ContactStream;
+
 struct ContactEvent {
 	struct Contact {
 		glm::vec3 globalContactPosition;
@@ -23,6 +25,13 @@ struct CollidingEvent : public ContactEvent {
 	bool colliding;
 };
 
+// emitted once per physics update, entities opt in with BodyInfo::callbacks
+struct ContactStreamEvent {
+	const ContactStream* stream;
+};
+
+// once per fixed step, or when threaded once per step taken since the last sync, all at the sync
+// commands sent from threaded handlers reach the next step together, so forces should be applied once per sync rather than per event
 struct PhysicsUpdateEvent {
 	double timestep;
 };
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "system\Renderer.hpp"
+#include "system\Hierarchy.hpp"
 
 #include "component\Transform.hpp"
 
@@ -15,9 +16,11 @@ void errorCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsiz
 Renderer::Renderer(const ConstructorInfo& constructorInfo) : 
 		_path(constructorInfo.path), 
 		_glLoader(constructorInfo.attributes),
-		_uniformNames(constructorInfo.uniformNames){
+		_uniformNames(constructorInfo.uniformNames),
+		_hierarchy(constructorInfo.hierarchy){
 
 	assert(constructorInfo.path != "");
+	assert(constructorInfo.hierarchy);
 	assert(constructorInfo.mainVertexShader != "");
 	assert(constructorInfo.mainFragmentShader != "");
 
@@ -117,7 +120,6 @@ void Renderer::update(entityx::EntityManager& entities, entityx::EventManager& e
 	GLint textureScaleLocation = glGetUniformLocation(_mainProgram.program, _uniformNames.textureScale.c_str());
 
 	for (auto entity : entities.entities_with_components<Transform, Model>()) {
-		const Transform& transform = *entity.component<Transform>().get();
 		const Model& model = *entity.component<Model>().get();
 	
 		if (!model.meshContext.indexCount || !model.textureContext.textureBuffer)
@@ -125,7 +127,7 @@ void Renderer::update(entityx::EntityManager& entities, entityx::EventManager& e
 	
 		// bind model matrix
 		if (modelLocation != -1)
-			glUniformMatrix4fv(modelLocation, 1, GL_FALSE, &transform.globalMatrix()[0][0]);
+			glUniformMatrix4fv(modelLocation, 1, GL_FALSE, &_hierarchy->globalMatrix(entity)[0][0]);
 	
 		// bind texture
 		if (textureLocation != -1) {
@@ -218,11 +220,11 @@ entityx::Entity Renderer::createScene(entityx::EntityManager& entities, const st
 		const auto node = sceneContext->nodes[i];
 
 		auto transform = children[i].assign<Transform>();
-		transform->parent = children[node.parentNodeIndex];
+		transform->setParent(children[i], children[node.parentNodeIndex]);
 
-		transform->position = node.position;
-		transform->rotation = node.rotation;
-		transform->scale = node.scale;
+		transform->setPosition(node.position);
+		transform->setRotation(node.rotation);
+		transform->setScale(node.scale);
 
 		if (node.hasMesh)
 			children[i].assign<Model>(Model::FilePaths{ meshFile, node.meshContextIndex });
@@ -243,13 +245,12 @@ glm::mat4 Renderer::viewMatrix() const {
 	if (!_camera.valid() || !_camera.has_component<Transform>() || !_camera.has_component<Camera>())
 		return glm::mat4();
 
-	auto transform = _camera.component<const Transform>();
 	auto camera = _camera.component<const Camera>();
 
 	glm::vec3 globalPosition;
 	glm::quat globalRotation;
 
-	transform->globalDecomposed(&globalPosition, &globalRotation);
+	_hierarchy->globalDecomposed(_camera, &globalPosition, &globalRotation);
 
 	glm::mat4 view;
 	view = glm::translate(view, globalPosition);
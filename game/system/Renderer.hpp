@@ -12,6 +12,8 @@
 
 #include "system\WindowEvents.hpp"
 
+class Hierarchy;
+
 class Renderer : public entityx::System<Renderer>, public entityx::Receiver<Renderer> {
 public:
 	struct UniformNames {
@@ -33,6 +35,8 @@ public:
 		std::string lineFragmentShader;
 
 		std::string defaultTexture;
+
+		const Hierarchy* hierarchy = nullptr;
 	};
 
 private:
@@ -43,6 +47,7 @@ private:
 
 	const std::string _path;
 	const UniformNames _uniformNames;
+	const Hierarchy* _hierarchy;
 
 	GlLoader _glLoader;
 